@@ -0,0 +1,474 @@
+#include "benchmarks/benchmarks.h"
+
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <sstream>
+#include <ctime>
+
+#include "dataloader/dataloader.h"
+#include "dataloader/binary_cache.h"
+#include "calculations/cpu/cpu_comps.h"
+#include "calculations/gpu/gpu_comps.h"
+#include "my_drawing/svg_generator.h"
+
+void benchmark_loaders(const std::vector<std::string> &files, size_t repetitions) {
+    /* Name and the loader itself -- wrapped, so that all of them have the same signature */
+    const std::vector<std::pair<std::string, std::function<void(const std::string &, patient_data &)>>> loaders = {
+        {"std (ifstream)", [](const std::string &file, patient_data &data) { load_data(file, data); }},
+        {"fast (fscanf)", [](const std::string &file, patient_data &data) { load_data_fast(file, data); }},
+        {"super_fast (fgets)", [](const std::string &file, patient_data &data) { load_data_super_fast(file, data); }},
+        {"parallel (seq)", [](const std::string &file, patient_data &data) { load_data_parallel(std::execution::seq, file, data); }},
+        {"parallel (par)", [](const std::string &file, patient_data &data) { load_data_parallel(std::execution::par, file, data); }},
+        {"mmap (seq)", [](const std::string &file, patient_data &data) { load_data_mmap(std::execution::seq, file, data); }},
+        {"mmap (par)", [](const std::string &file, patient_data &data) { load_data_mmap(std::execution::par, file, data); }},
+        {"mmap (par) + timestamps", [](const std::string &file, patient_data &data) { load_data_mmap(std::execution::par, file, data, true); }},
+        {"stream (1 parser)", [](const std::string &file, patient_data &data) { load_data_stream(file, data, 1); }},
+        {"stream (all parsers)", [](const std::string &file, patient_data &data) { load_data_stream(file, data); }},
+    };
+
+    for (const auto &file : files) {
+        const auto file_size = static_cast<double>(std::filesystem::file_size(file));
+        std::cout << "Loader benchmark for " << file << " (" << file_size / MB << " MB, median of " << repetitions << " runs):" << std::endl;
+        std::cout << std::left << std::setw(24) << "Loader" << std::right << std::setw(12) << "Time (ms)" << std::setw(16) << "Speed (MB/s)" << std::setw(12) << "Rows" << std::endl;
+
+        for (const auto &[name, loader] : loaders) {
+            patient_data data;
+            const auto time = median_time_ms(repetitions, [&]() { loader(file, data); });
+
+            std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << time << std::setw(16) << file_size / MB / (time / 1000.0)
+                      << std::setw(12) << data.x.size() << std::defaultfloat << std::endl;
+        }
+
+        /* Binary cache -- only if there is a valid one (written by a previous run with the --cache flag) */
+        patient_data data;
+        if (load_data_cache(file, data)) {
+            const auto time = median_time_ms(repetitions, [&]() { load_data_cache(file, data); });
+            std::cout << std::left << std::setw(24) << "cache (binary)" << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << time << std::setw(16) << file_size / MB / (time / 1000.0)
+                      << std::setw(12) << data.x.size() << std::defaultfloat << std::endl;
+        } else {
+            std::cout << "cache (binary): no valid cache, run with --cache first" << std::endl;
+        }
+
+        std::cout << std::endl;
+    }
+}
+
+void benchmark_parsers(const std::vector<std::string> &files, size_t repetitions) {
+    /* Numbers of threads to be measured -- powers of two and the maximum */
+    const size_t max_num_threads = std::thread::hardware_concurrency();
+    std::vector<size_t> thread_counts;
+    for (size_t num_threads = 1; num_threads < max_num_threads; num_threads *= 2)
+        thread_counts.push_back(num_threads);
+    thread_counts.push_back(max_num_threads);
+
+    /* Line parser using strtod / strtof -- what the loaders used before parse_decimal */
+    const auto parse_line_strtod = [](const char *line_ptr, const char *end, patient_data &data, size_t index) {
+        const char *commas[3];
+        if (find_commas(line_ptr, end, commas, 3) < 3)
+            return;
+        #ifndef _USE_FLOAT
+        data.x[index] = std::strtod(commas[0] + 1, nullptr);
+        data.y[index] = std::strtod(commas[1] + 1, nullptr);
+        data.z[index] = std::strtod(commas[2] + 1, nullptr);
+        #else
+        data.x[index] = std::strtof(commas[0] + 1, nullptr);
+        data.y[index] = std::strtof(commas[1] + 1, nullptr);
+        data.z[index] = std::strtof(commas[2] + 1, nullptr);
+        #endif
+    };
+
+    for (const auto &file : files) {
+        mapped_file mapping;
+        map_file(file, mapping);
+        const char *end = mapping.data + mapping.size;
+        const char *begin = next_line(mapping.data, end);
+
+        /* Only newline terminated lines are parsed, so that strtod never runs past the mapping */
+        while (end > begin && *(end - 1) != '\n')
+            end--;
+        const auto file_size = static_cast<double>(end - begin);
+
+        /* Output columns (one row per line) */
+        patient_data data;
+        const size_t num_lines = count_char(begin, end, '\n');
+        data.x.resize(num_lines);
+        data.y.resize(num_lines);
+        data.z.resize(num_lines);
+
+        std::cout << "Parser benchmark for " << file << " (" << file_size / MB << " MB, median of " << repetitions << " runs):" << std::endl;
+        std::cout << std::setw(8) << "Threads" << std::setw(18) << "strtod (MB/s)" << std::setw(22) << "parse_decimal (MB/s)"
+                  << std::setw(22) << "per thread (MB/s)" << std::setw(10) << "Speedup" << std::endl;
+
+        for (const auto num_threads : thread_counts) {
+            const auto chunk_starts = split_lines(begin, end, num_threads);
+
+            /* Rows where the chunks start */
+            std::vector<size_t> chunk_rows(num_threads, 0);
+            for (size_t i = 1; i < num_threads; i++)
+                chunk_rows[i] = chunk_rows[i - 1] + count_char(chunk_starts[i - 1], chunk_starts[i], '\n');
+
+            /* Parse the whole file with the given line parser, one std::thread per chunk */
+            const auto run = [&](const auto &line_parser) {
+                std::vector<std::thread> threads;
+                for (size_t i = 0; i < num_threads; i++)
+                    threads.emplace_back([&, i]() {
+                        size_t row = chunk_rows[i];
+                        for (const char *line_ptr = chunk_starts[i]; line_ptr < chunk_starts[i + 1]; line_ptr = next_line(line_ptr, end))
+                            line_parser(line_ptr, end, data, row++);
+                    });
+                for (auto &thread : threads)
+                    thread.join();
+            };
+
+            const auto time_strtod = median_time_ms(repetitions, [&]() { run(parse_line_strtod); });
+            const auto time_fast = median_time_ms(repetitions, [&]() { run([](const char *line_ptr, const char *end, patient_data &data, size_t row) { parse_line(line_ptr, end, data, row); }); });
+            const auto speed_strtod = file_size / MB / (time_strtod / 1000.0);
+            const auto speed_fast = file_size / MB / (time_fast / 1000.0);
+
+            std::cout << std::fixed << std::setprecision(2) << std::setw(8) << num_threads << std::setw(18) << speed_strtod
+                      << std::setw(22) << speed_fast << std::setw(22) << speed_fast / static_cast<double>(num_threads)
+                      << std::setw(9) << speed_fast / speed_strtod << "x" << std::defaultfloat << std::endl;
+        }
+
+        std::cout << std::endl;
+        unmap_file(mapping);
+    }
+}
+
+void benchmark_memory(const std::vector<std::string> &files, size_t repetitions) {
+    /* The kernels are memory bound only on large arrays -- small files are repeated to get at least this many elements */
+    constexpr size_t min_kernel_elements = 1 << 24;
+
+    for (const auto &file : files) {
+        patient_data data;
+        load_data_mmap(std::execution::par, file, data);
+        const size_t n = data.x.size();
+        if (n == 0)
+            continue;
+        std::cout << "Memory benchmark for " << file << " (" << n << " X data, median of " << repetitions << " runs):" << std::endl;
+        std::cout << std::left << std::setw(44) << "Variant" << std::right << std::setw(12) << "Time (ms)" << std::endl;
+
+        const auto print = [](const std::string &name, double time) {
+            std::cout << std::left << std::setw(44) << name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << time << std::defaultfloat << std::endl;
+        };
+
+        /* Kernel -- the same data, one copy misaligned by one element in a std::vector, one in a decimal_vector */
+        const size_t kernel_n = std::max(n, min_kernel_elements);
+        std::vector<decimal> plain(kernel_n + 1);
+        decimal_vector aligned(kernel_n);
+        for (size_t i = 0; i < kernel_n; i++)
+            plain[i + 1] = aligned[i] = data.x[i % n];
+
+        /* Sums kernel of the best instruction set of the CPU */
+        const auto &kernels = get_simd_kernels();
+        const std::string kernel_name = std::string("sums (") + simd_isa_name(kernels.isa) + ")";
+        volatile decimal sink = 0;  /* Keeps the results alive */
+        decimal sum, sum_sq;
+        print(kernel_name + ", loadu, std::vector (+1)", median_time_ms(repetitions, [&]() {
+            sum = sum_sq = 0;
+            kernels.sums_unaligned(plain.data() + 1, kernel_n, sum, sum_sq);
+            sink = sum_sq;
+        }));
+        print(kernel_name + ", load, decimal_vector", median_time_ms(repetitions, [&]() {
+            sum = sum_sq = 0;
+            kernels.sums(aligned.data(), kernel_n, sum, sum_sq);
+            sink = sum_sq;
+        }));
+
+        /* Whole computation (vectorized, parallel) -- including the allocations of the copy, the diff and the merge sort */
+        for (const bool huge_pages : {false, true}) {
+            huge_pages_enabled = huge_pages;
+            const auto time = median_time_ms(repetitions, [&]() {
+                decimal_vector copy(data.x.begin(), data.x.end());
+                vec_comp comp;
+                sink = comp.compute_coef_var(std::execution::par, copy);
+                sink = comp.compute_mad(std::execution::par, copy);
+            });
+            print(huge_pages ? "MAD + CV, huge pages (MADV_HUGEPAGE)" : "MAD + CV, 4 KB pages", time);
+        }
+        huge_pages_enabled = false;
+
+        std::cout << std::endl;
+    }
+}
+
+void benchmark_sorts(const std::vector<std::string> &files, size_t num_batches, size_t repetitions, bool plot) {
+    /* Name and the sort itself -- wrapped, so that all of them have the same signature (the workspace of the sort is given) */
+    const auto &best_kernels = get_simd_kernels();
+    const auto simd_bucket_sort = [&best_kernels](decimal *bucket, decimal *buffer, size_t n) { simd_merge_sort_range(bucket, buffer, n, best_kernels); };
+    std::vector<std::pair<std::string, std::function<void(decimal_vector &, workspace &)>>> sorts = {
+        {"merge (seq)", [](decimal_vector &arr, workspace &ws) { merge_sort(std::execution::seq, arr, ws); }},
+        {"merge (par)", [](decimal_vector &arr, workspace &ws) { merge_sort(std::execution::par, arr, ws); }},
+    };
+    /* Vectorized merge sort with the kernels of every instruction set supported by the CPU */
+    for (const auto isa : simd_isas) {
+        if (!simd_isa_supported(isa))
+            continue;
+        const auto &kernels = get_simd_kernels(isa);
+        sorts.emplace_back(std::string("simd ") + simd_isa_name(isa) + " (seq)", [&kernels](decimal_vector &arr, workspace &ws) { simd_merge_sort(std::execution::seq, arr, ws, kernels); });
+        sorts.emplace_back(std::string("simd ") + simd_isa_name(isa) + " (par)", [&kernels](decimal_vector &arr, workspace &ws) { simd_merge_sort(std::execution::par, arr, ws, kernels); });
+    }
+    sorts.insert(sorts.end(), {
+        {"radix (seq)", [](decimal_vector &arr, workspace &ws) { radix_sort(std::execution::seq, arr, ws); }},
+        {"radix (par)", [](decimal_vector &arr, workspace &ws) { radix_sort(std::execution::par, arr, ws); }},
+        {"sample (par)", [](decimal_vector &arr, workspace &ws) { sample_sort(std::execution::par, arr, merge_sort_range, ws); }},
+        {"sample simd (par)", [&](decimal_vector &arr, workspace &ws) { sample_sort(std::execution::par, arr, simd_bucket_sort, ws); }},
+    });
+
+    /* Sorts for the scaling measurement -- the number of threads is given */
+    const std::vector<std::pair<std::string, std::function<void(decimal_vector &, workspace &, size_t)>>> scaling_sorts = {
+        {"merge", [](decimal_vector &arr, workspace &ws, size_t num_threads) { merge_sort(std::execution::par, arr, ws, num_threads); }},
+        {"sample", [](decimal_vector &arr, workspace &ws, size_t num_threads) { sample_sort(std::execution::par, arr, merge_sort_range, ws, num_threads); }},
+        {"sample simd", [&](decimal_vector &arr, workspace &ws, size_t num_threads) { sample_sort(std::execution::par, arr, simd_bucket_sort, ws, num_threads); }},
+    };
+
+    /* Numbers of threads for the scaling -- powers of two and the maximum */
+    const size_t max_num_threads = std::thread::hardware_concurrency();
+    std::vector<size_t> thread_counts;
+    for (size_t num_threads = 1; num_threads < max_num_threads; num_threads *= 2)
+        thread_counts.push_back(num_threads);
+    thread_counts.push_back(max_num_threads);
+
+    for (const auto &file : files) {
+        patient_data data;
+        load_data_mmap(std::execution::par, file, data);
+        std::cout << "Sort benchmark for " << file << " (X data, time in ms, median of " << repetitions << " runs):" << std::endl;
+
+        std::cout << std::setw(12) << "Elements";
+        for (const auto &sort : sorts)
+            std::cout << std::setw(18) << sort.first;
+        std::cout << std::setw(8) << "Same" << std::endl;
+
+        /* For each split chunk (batch) of the loaded data -- the same sizes as in the computations */
+        for (size_t i = 0; i < num_batches; i++) {
+            const auto num_data_points = i != num_batches - 1 ? data.x.size() / num_batches * (i + 1) : data.x.size();
+            const decimal_vector batch(data.x.begin(), data.x.begin() + static_cast<long>(num_data_points));
+
+            std::cout << std::setw(12) << num_data_points;
+            decimal_vector reference;
+            bool same = true;
+            for (const auto &sort : sorts) {
+                /* Workspace of the sort, warmed up by one run that is not measured (the real paths reuse theirs too) */
+                workspace ws;
+                decimal_vector arr = batch;
+                sort.second(arr, ws);
+
+                std::vector<double> times(std::max<size_t>(repetitions, 1));
+                for (auto &time : times) {
+                    arr = batch;  /* Fresh unsorted copy for each run -- not measured */
+                    time = median_time_ms(1, [&]() { sort.second(arr, ws); });
+                }
+                std::sort(times.begin(), times.end());
+
+                if (reference.empty())
+                    reference = arr;
+                same = same && arr == reference;
+                std::cout << std::fixed << std::setprecision(2) << std::setw(18)
+                          << (times[times.size() / 2] + times[(times.size() - 1) / 2]) / 2.0 << std::defaultfloat;
+            }
+            std::cout << std::setw(8) << (same ? "yes" : "NO") << std::endl;
+        }
+        std::cout << std::endl;
+
+        /* Scaling -- the whole X data, 1 thread up to hardware_concurrency() */
+        std::cout << "Sort scaling for " << file << " (" << data.x.size() << " elements, time in ms, median of " << repetitions << " runs):" << std::endl;
+        std::cout << std::setw(12) << "Threads";
+        for (const auto &sort : scaling_sorts)
+            std::cout << std::setw(18) << sort.first;
+        std::cout << std::endl;
+
+        std::vector<std::vector<double>> x_values_list(scaling_sorts.size());
+        std::vector<std::vector<double>> y_values_list(scaling_sorts.size());
+        for (const auto num_threads : thread_counts) {
+            std::cout << std::setw(12) << num_threads;
+            for (size_t j = 0; j < scaling_sorts.size(); j++) {
+                /* Workspace of the sort, warmed up by one run that is not measured */
+                workspace ws;
+                decimal_vector arr = data.x;
+                scaling_sorts[j].second(arr, ws, num_threads);
+
+                std::vector<double> times(std::max<size_t>(repetitions, 1));
+                for (auto &time : times) {
+                    arr = data.x;  /* Fresh unsorted copy for each run -- not measured */
+                    time = median_time_ms(1, [&]() { scaling_sorts[j].second(arr, ws, num_threads); });
+                }
+                std::sort(times.begin(), times.end());
+                const auto time = (times[times.size() / 2] + times[(times.size() - 1) / 2]) / 2.0;
+
+                x_values_list[j].push_back(static_cast<double>(num_threads));
+                y_values_list[j].push_back(time);
+                std::cout << std::fixed << std::setprecision(2) << std::setw(18) << time << std::defaultfloat;
+            }
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+
+        if (plot) {
+            /* Same naming as the plots of the computations -- res/<file>/<date>_sort_scaling.svg */
+            std::string name = file;
+            if (name.find('/') != std::string::npos)
+                name = name.substr(name.find_last_of('/') + 1);
+            if (name.find('.') != std::string::npos)
+                name = name.substr(0, name.find('.'));
+            std::filesystem::create_directories("res/" + name);
+
+            const auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            std::ostringstream oss;
+            oss << std::put_time(std::localtime(&now), "%Y-%m-%d_%H-%M-%S");
+
+            std::vector<std::string> labels;
+            for (const auto &sort : scaling_sorts)
+                labels.push_back(sort.first);
+            plot_line_chart("res/" + name + "/" + oss.str() + "_sort_scaling.svg", x_values_list, y_values_list,
+                            "Sort scaling (" + std::to_string(data.x.size()) + " elements)", "Threads", "Time (ms)", labels);
+        }
+    }
+}
+
+/**
+ * Distance of the normalized rank of a value in a sorted array from 1/2 (0 if a median of the array has the value)
+ * @param sorted Sorted array
+ * @param value Value
+ * @return Observed rank error of the value as a median
+ */
+static double median_rank_error(const decimal_vector &sorted, decimal value) {
+    const auto n = static_cast<double>(sorted.size());
+    const auto low = static_cast<double>(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin()) / n;
+    const auto high = static_cast<double>(std::upper_bound(sorted.begin(), sorted.end(), value) - sorted.begin()) / n;
+
+    return std::max({low - 0.5, 0.5 - high, 0.0});
+}
+
+void benchmark_gpu_sorts(const std::vector<std::string> &files, size_t num_batches, size_t repetitions) {
+    /* One GPU backend for all the runs (OpenCL initialization is not measured), the sort is chosen by its options */
+    gpu_comps gpu;
+    comp_options bitonic_options, radix_options;
+    radix_options.sort = sort_algorithm::radix;
+
+    /* Name and the sort itself -- wrapped, so that all of them have the same signature */
+    const std::vector<std::pair<std::string, std::function<void(decimal_vector &)>>> sorts = {
+        {"merge (CPU seq)", [](decimal_vector &arr) { workspace ws; merge_sort(std::execution::seq, arr, ws); }},
+        {"bitonic (GPU)", [&](decimal_vector &arr) { workspace ws; gpu.set_options(bitonic_options); gpu.sort(std::execution::seq, arr, ws); }},
+        {"radix (GPU)", [&](decimal_vector &arr) { workspace ws; gpu.set_options(radix_options); gpu.sort(std::execution::seq, arr, ws); }},
+    };
+
+    for (const auto &file : files) {
+        patient_data data;
+        load_data_mmap(std::execution::par, file, data);
+        std::cout << "GPU sort benchmark for " << file << " (X data, time in ms, median of " << repetitions << " runs):" << std::endl;
+
+        std::cout << std::setw(12) << "Elements";
+        for (const auto &sort : sorts)
+            std::cout << std::setw(18) << sort.first;
+        std::cout << std::setw(8) << "Same" << std::endl;
+
+        /* For each split chunk (batch) of the loaded data -- the same sizes as in the computations */
+        for (size_t i = 0; i < num_batches; i++) {
+            const auto num_data_points = i != num_batches - 1 ? data.x.size() / num_batches * (i + 1) : data.x.size();
+            const decimal_vector batch(data.x.begin(), data.x.begin() + static_cast<long>(num_data_points));
+
+            std::cout << std::setw(12) << num_data_points;
+            decimal_vector reference;
+            bool same = true;
+            for (const auto &sort : sorts) {
+                decimal_vector arr;
+                std::vector<double> times(std::max<size_t>(repetitions, 1));
+                for (auto &time : times) {
+                    arr = batch;  /* Fresh unsorted copy for each run -- not measured */
+                    time = median_time_ms(1, [&]() { sort.second(arr); });
+                }
+                std::sort(times.begin(), times.end());
+
+                if (reference.empty())
+                    reference = arr;
+                same = same && arr == reference;
+                std::cout << std::fixed << std::setprecision(2) << std::setw(18)
+                          << (times[times.size() / 2] + times[(times.size() - 1) / 2]) / 2.0 << std::defaultfloat;
+            }
+            std::cout << std::setw(8) << (same ? "yes" : "NO") << std::endl;
+        }
+        std::cout << std::endl;
+    }
+}
+
+void benchmark_approx(const std::vector<std::string> &files, size_t repetitions) {
+    /* Accuracy parameters of the sketches */
+    const std::vector<size_t> ks = {50, 100, 200, 400, 800, 1600};
+
+    for (const auto &file : files) {
+        patient_data data;
+        load_data_mmap(std::execution::par, file, data);
+        const size_t n = data.x.size();
+        if (n == 0)
+            continue;
+        std::cout << "Approximate MAD benchmark for " << file << " (" << n << " X data, time in ms, median of " << repetitions << " runs):" << std::endl;
+        std::cout << std::left << std::setw(26) << "Variant" << std::right << std::setw(12) << "Time" << std::setw(14) << "Median"
+                  << std::setw(14) << "MAD" << std::setw(16) << "Median err %" << std::setw(14) << "MAD err %"
+                  << std::setw(12) << "Bound %" << std::setw(10) << "Stored" << std::endl;
+
+        /* Exact values -- sorted data and sorted absolute deviations from the exact median (for the observed rank errors) */
+        decimal_vector sorted(data.x.begin(), data.x.end());
+        std::sort(sorted.begin(), sorted.end());
+        const auto exact_median = static_cast<decimal>((sorted[n / 2] + sorted[(n - 1) / 2]) / 2.0);
+        decimal_vector deviations(n);
+        std::transform(sorted.begin(), sorted.end(), deviations.begin(), [&](decimal val) { return std::abs(val - exact_median); });
+        std::sort(deviations.begin(), deviations.end());
+
+        const auto print = [&](const std::string &name, double time, decimal median, decimal mad, double bound, size_t stored) {
+            std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(12) << time << std::setprecision(6) << std::setw(14) << median << std::setw(14) << mad
+                      << std::setprecision(3) << std::setw(16) << median_rank_error(sorted, median) * 100.0
+                      << std::setw(14) << median_rank_error(deviations, mad) * 100.0 << std::defaultfloat;
+            if (bound > 0)
+                std::cout << std::fixed << std::setprecision(3) << std::setw(12) << bound * 100.0 << std::setw(10) << stored << std::defaultfloat;
+            std::cout << std::endl;
+        };
+
+        /* Measure the MAD of the backend with the given options (a fresh unsorted copy for each run -- not measured) */
+        const auto measure = [&](auto execution, const comp_options &options) {
+            vec_comp comp;
+            comp.set_options(options);
+            decimal_vector copy;
+            decimal mad = 0;
+            std::vector<double> times(std::max<size_t>(repetitions, 1));
+            for (auto &time : times) {
+                copy = data.x;
+                time = median_time_ms(1, [&]() { mad = comp.compute_mad(execution, copy); });
+            }
+            std::sort(times.begin(), times.end());
+            return std::make_pair((times[times.size() / 2] + times[(times.size() - 1) / 2]) / 2.0, mad);
+        };
+
+        /* Exact backends */
+        for (const auto mad : {mad_algorithm::sort, mad_algorithm::select}) {
+            comp_options options;
+            options.mad = mad;
+            const auto [time, exact_mad] = measure(std::execution::par, options);
+            print(mad == mad_algorithm::sort ? "exact sort (vec, par)" : "exact select (vec, par)", time, exact_median, exact_mad, 0, 0);
+        }
+
+        /* Sketches -- parallel for every k, sequential for the default one */
+        for (const auto k : ks) {
+            comp_options options;
+            options.mad = mad_algorithm::approx;
+            options.sketch_k = k;
+
+            /* The estimated median and the size of the merged sketch (not measured) */
+            workspace ws;
+            const auto median = vec_comp::sketch_median(std::execution::par, data.x, [](decimal val) { return val; }, k, ws);
+            const size_t stored = ws.sketches[0].stored();
+
+            const auto [time, mad] = measure(std::execution::par, options);
+            print("approx k=" + std::to_string(k) + " (par)", time, median, mad, kll_sketch::rank_error(k), stored);
+            if (k == kll_default_k) {
+                const auto [seq_time, seq_mad] = measure(std::execution::seq, options);
+                print("approx k=" + std::to_string(k) + " (seq)", seq_time, median, seq_mad, kll_sketch::rank_error(k), stored);
+            }
+        }
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "utils/utils.h"
+
+/**
+ * Run the given function n number of times and measure the median of the run times
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam function Callable without arguments
+ * @param repetitions Number of repetitions (at least one run is always made)
+ * @param fn Function to be measured
+ * @return Median run time in milliseconds
+ */
+template <typename function>
+double median_time_ms(size_t repetitions, function &&fn) {
+    std::vector<double> times(std::max<size_t>(repetitions, 1));
+
+    for (auto &time : times) {
+        auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+        time = std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    std::sort(times.begin(), times.end());
+    return (times[times.size() / 2] + times[(times.size() - 1) / 2]) / 2.0;
+}
+
+/**
+ * Benchmark all the data loaders (load_data, load_data_fast, load_data_super_fast, load_data_parallel, load_data_mmap, load_data_stream)
+ * Prints the median load time and throughput (MB/s) of each loader for each file
+ * @param files Files to be loaded
+ * @param repetitions Number of repetitions for each loader (median is printed out)
+ */
+void benchmark_loaders(const std::vector<std::string> &files, size_t repetitions);
+
+/**
+ * Benchmark the number parsers (strtod / strtof vs. the locale-free parse_decimal) inside of the mmap loader
+ * The file is parsed by 1, 2, 4, ... up to hardware_concurrency() threads, each parsing a line aligned byte range
+ * Prints the throughput (MB/s) of both parsers for each number of threads and the speedup
+ * @param files Files to be parsed
+ * @param repetitions Number of repetitions for each measurement (median is printed out)
+ */
+void benchmark_parsers(const std::vector<std::string> &files, size_t repetitions);
+
+/**
+ * Benchmark the storage of the data arrays (decimal_vector vs. plain std::vector)
+ * Compares the sums kernel (of the best instruction set of the CPU) with unaligned loads on a misaligned std::vector to
+ * aligned loads on decimal_vector, and the whole MAD + CV computation (vectorized, parallel) on 4 KB pages vs.
+ * transparent huge pages
+ * @param files Files to be loaded (X data is used)
+ * @param repetitions Number of repetitions for each measurement (median is printed out)
+ */
+void benchmark_memory(const std::vector<std::string> &files, size_t repetitions);
+
+/**
+ * Benchmark the CPU sorts (merge_sort, simd_merge_sort, radix_sort and sample_sort) on the X data of each file
+ * simd_merge_sort is measured with the kernels of every instruction set supported by the CPU
+ * The data is split into the same batches as the computations (-n flag), each batch size is measured separately
+ * Prints the median sort time of each sort and whether the sorted arrays are the same
+ * Each sort reuses its own workspace, warmed up by one run that is not measured (as in the computations)
+ * Then measures the scaling of the parallel merge sort and sample sort on the whole X data, from 1 thread up to
+ * hardware_concurrency() threads, and plots it (res/<file>/<date>_sort_scaling.svg)
+ * @param files Files to be loaded (X data is used)
+ * @param num_batches Number of batches to split the data into
+ * @param repetitions Number of repetitions for each measurement (median is printed out)
+ * @param plot Plot the scaling (false if the --no_graphs flag was used)
+ */
+void benchmark_sorts(const std::vector<std::string> &files, size_t num_batches, size_t repetitions, bool plot);
+
+/**
+ * Benchmark the GPU sorts (bitonic sort and radix sort of gpu_comps) on the X data of each file
+ * The data is split into the same batches as the computations (-n flag), each batch size is measured separately
+ * Every run includes the upload of the batch and the download of the sorted array (as in the computations)
+ * Prints the median sort time of both sorts, the one of the sequential CPU merge sort for comparison, and whether the
+ * sorted arrays are the same
+ * @param files Files to be loaded (X data is used)
+ * @param num_batches Number of batches to split the data into
+ * @param repetitions Number of repetitions for each measurement (median is printed out)
+ */
+void benchmark_gpu_sorts(const std::vector<std::string> &files, size_t num_batches, size_t repetitions);
+
+/**
+ * Benchmark the approximate MAD (quantile sketches) against the exact backends on the X data of each file
+ * The exact MAD is computed by the sort and by the selection (vectorized, parallel), the approximate one for several
+ * accuracy parameters k (parallel, and sequential for the default k)
+ * Prints the median time, the estimates, their observed rank errors (distance of their rank in the data from 1/2), the a
+ * priori rank error bound and the number of items stored in the merged sketch
+ * @param files Files to be loaded (X data is used)
+ * @param repetitions Number of repetitions for each measurement (median is printed out)
+ */
+void benchmark_approx(const std::vector<std::string> &files, size_t repetitions);
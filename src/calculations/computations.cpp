@@ -1,3 +1,7 @@
 #include "calculations/computations.h"
 
-/* Unused because of template functions, that need to be implemented in the header file */
+/* Most of the computations are template functions, that need to be implemented in the header file */
+
+decimal kth_abs_deviation(const decimal_vector &arr, const decimal median, const size_t k) {
+    return kth_abs_deviation(arr.size(), [&arr](const size_t i) { return arr[i]; }, median, k);
+}
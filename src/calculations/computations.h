@@ -1,12 +1,129 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <cmath>
+#include <numeric>
+#include <thread>
 
+#include <execution>
+
+#include "calculations/workspace.h"
+#include "simd/cpu_features.h"
 #include "utils/utils.h"
 
 /* This, and the arg parser, are the only files where I found OOP to be useful */
 
+/**
+ * Algorithm used for the medians of the MAD computation
+ */
+enum class mad_algorithm {
+    /** Sort the array, take the middle elements and walk outwards from them for the median of the deviations */
+    sort,
+    /** Select the middle elements (quickselect) of the array, then of the absolute deviations -- no sort at all */
+    select,
+    /** Estimate both medians by quantile sketches (KLL) built in parallel -- approximate, O(k log(n / k)) memory */
+    approx
+};
+
+/**
+ * Algorithm used for sorting on the CPU (the GPU uses its radix sort for radix, its bitonic sort otherwise)
+ */
+enum class sort_algorithm {
+    /** Bottom-up merge sort (merge_sort.h) */
+    merge,
+    /** LSD radix sort on the bits of the numbers (radix_sort.h) */
+    radix,
+    /** Parallel sample sort, the buckets sorted by the merge sort of the backend (sample_sort.h) */
+    sample
+};
+
+/**
+ * Options of the computations chosen by the user (the same ones for all the backends)
+ */
+struct comp_options {
+    /** Algorithm used for the medians of the MAD computation (--mad flag) */
+    mad_algorithm mad = mad_algorithm::sort;
+    /** Algorithm used for sorting (--sort flag) */
+    sort_algorithm sort = sort_algorithm::merge;
+    /** Instruction set of the vectorized computations (--isa flag) -- the best one supported by the CPU by default */
+    simd_isa isa = detect_simd_isa();
+    /** Compute X, Y and Z together -- fused sums, concurrent MADs (--fused flag) */
+    bool fused = false;
+    /** Accuracy parameter of the quantile sketches of the approximate MAD (--sketch_k flag) */
+    size_t sketch_k = kll_default_k;
+};
+
+/**
+ * Find the k-th smallest absolute difference from the median of a sorted array, without computing the differences
+ * The differences left of the center (n / 2 - 1 down to 0) and right of it (n / 2 up to n - 1) are two sorted sequences,
+ * the k-th smallest of both is found by a binary search on the merge path of the two sequences -- O(log n)
+ * The differences are computed exactly like in compute_abs_diff (|x - median|), so the result is the same as from the
+ * sorted array of the differences
+ * @param arr Sorted array (not empty)
+ * @param median Median of the array
+ * @param k Rank of the wanted difference (0 = the smallest, k < arr.size())
+ * @return The k-th smallest absolute difference
+ */
+decimal kth_abs_deviation(const decimal_vector &arr, decimal median, size_t k);
+
+/**
+ * Find the k-th smallest absolute difference from the median of any sorted sequence (see the overload above)
+ * The sequence is read only through the accessor, O(log n) times -- it does not have to be stored as an array
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam accessor Function returning the i-th smallest element of the sequence (decimal(size_t))
+ * @param size Number of elements of the sequence (not zero)
+ * @param at The i-th smallest element of the sequence
+ * @param median Median of the sequence
+ * @param k Rank of the wanted difference (0 = the smallest, k < size)
+ * @return The k-th smallest absolute difference
+ */
+template <typename accessor>
+decimal kth_abs_deviation(const size_t size, accessor at, const decimal median, const size_t k) {
+    const size_t center = size / 2;
+
+    /* Differences of the left side (from the center to the left) and of the right side -- both growing */
+    const size_t num_left = center;
+    const size_t num_right = size - center;
+    const auto left = [&](const size_t i) { return std::abs(at(center - 1 - i) - median); };
+    const auto right = [&](const size_t i) { return std::abs(at(center + i) - median); };
+
+    /* How many of the k + 1 smallest differences are on the left side (binary search on the merge path) */
+    const size_t diag = k + 1;
+    size_t low = diag > num_right ? diag - num_right : 0;
+    size_t high = std::min(diag, num_left);
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (left(mid) <= right(diag - mid - 1))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    /* The k-th smallest is the larger one of the last elements taken from both sides */
+    const size_t taken_left = low;
+    const size_t taken_right = diag - low;
+    if (taken_left == 0)
+        return right(taken_right - 1);
+    if (taken_right == 0)
+        return left(taken_left - 1);
+    return std::max(left(taken_left - 1), right(taken_right - 1));
+}
+
+/**
+ * State of the incremental computation over the growing prefixes of a series (see computations::extend_prefix)
+ */
+struct prefix_state {
+    /** Elements of the prefix, sorted */
+    decimal_vector sorted;
+    /** Output of the merge of the prefix with the new elements (swapped with sorted afterwards) */
+    decimal_vector merged;
+    /** Sum of the elements of the prefix */
+    decimal sum = 0;
+    /** Sum of squares of the elements of the prefix */
+    decimal sum_sq = 0;
+};
+
 /**
  * Abstract class for computations
  * Defines the computation of MAD and CV (mean absolute deviation and coefficient of variance)
@@ -17,7 +134,57 @@
  */
 template<typename derived>
 class computations {
+protected:
+    /** Options of the computations (--mad, --sort, --isa, --fused and --sketch_k flags) */
+    comp_options options;
+    /** Scratch buffers reused by all the computations of this instance */
+    workspace ws;
+    /** Scratch buffers of the series computed concurrently (compute_series), one per series */
+    std::vector<workspace> series_ws;
+
+    /**
+     * Compute the coefficient of variance from the sums
+     * @param sum Sum of the elements
+     * @param sum_sq Sum of squares of the elements
+     * @param count Number of elements
+     * @return Coefficient of variance
+     */
+    [[nodiscard]] static decimal coef_var_from_sums(decimal sum, decimal sum_sq, size_t count) {
+        /* Using the formula: sqrt((sum of squares - sum^2 / n) / n) / (sum / n) */
+        const auto n = static_cast<double>(count);
+
+        return static_cast<decimal>(std::sqrt((sum_sq - sum * sum / n) / n) / (sum / n));
+    }
+
 public:
+    /**
+     * Set the options of the computations
+     * @param new_options Options
+     */
+    void set_options(const comp_options &new_options) {
+        this->options = new_options;
+    }
+
+    /**
+     * Get the options of the computations
+     * @return Options
+     */
+    [[nodiscard]] const comp_options &get_options() const {
+        return this->options;
+    }
+
+    /**
+     * Get the number of allocations made by the workspace so far (zero growth = no allocations in the computations)
+     * @return Number of allocations
+     */
+    [[nodiscard]] size_t get_allocations() const {
+        size_t allocations = this->ws.allocations;
+        for (const auto &series_workspace : this->series_ws)
+            allocations += series_workspace.allocations;
+
+        return allocations;
+    }
+
     /**
      * Compute the mean absolute deviation of a sorted array
      * This function has to be implemented in here (.h), because of the template
@@ -27,34 +194,180 @@ public:
      * @return Mean absolute deviation
      */
     template <typename exec_policy>
-    [[nodiscard]] decimal compute_mad(exec_policy policy, std::vector<decimal> &arr) {
+    [[nodiscard]] decimal compute_mad(exec_policy policy, decimal_vector &arr) {
+        return this->compute_mad(policy, arr, this->ws);
+    }
+
+    /**
+     * Compute the mean absolute deviation of a sorted array with the given workspace (one per concurrently computed series)
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Any array -- unsorted
+     * @param ws Workspace of the computation
+     * @return Mean absolute deviation
+     */
+    template <typename exec_policy>
+    [[nodiscard]] decimal compute_mad(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        const decimal mad = this->compute_mad_chosen(policy, arr, ws);
+
+        /* The series is done -- nothing kept for it may be used by the next computation (whatever algorithm was used) */
+        static_cast<derived *>(this)->end_series();
+        return mad;
+    }
+
+    /**
+     * End of the computations of a series (its sums and its MAD) -- nothing to do by default
+     * The derived class may hide this function to drop what it keeps for the series (the GPU input buffer)
+     */
+    void end_series() {
+    }
+
+    /**
+     * Compute the mean absolute deviation by the chosen algorithm (--mad flag), see compute_mad()
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Any array -- unsorted
+     * @param ws Workspace of the computation
+     * @return Mean absolute deviation
+     */
+    template <typename exec_policy>
+    [[nodiscard]] decimal compute_mad_chosen(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Selection or sketches instead of the sort */
+        if (this->options.mad == mad_algorithm::select)
+            return static_cast<derived *>(this)->compute_mad_select(policy, arr, ws);
+        if (this->options.mad == mad_algorithm::approx)
+            return this->compute_mad_approx(policy, arr, ws);
+
+        /* Nothing to compute (the same result as the selection) */
+        if (arr.empty())
+            return 0;
+
         /* Sort the array for median calculation */
-        static_cast<derived *>(this)->sort(policy, arr);
+        static_cast<derived *>(this)->sort(policy, arr, ws);
+
+        return mad_of_sorted(arr);
+    }
 
+    /**
+     * Compute the mean absolute deviation of a sorted array (not empty)
+     * @param arr Sorted array
+     * @return Mean absolute deviation
+     */
+    [[nodiscard]] static decimal mad_of_sorted(const decimal_vector &arr) {
         /* Get the median */
         const auto median = static_cast<decimal>((arr[arr.size() / 2] + arr[(arr.size() - 1) / 2]) / 2.0);
 
-        /* Calculate the absolute differences from the median */
-        std::vector<decimal> diff(arr.size());
-
-        static_cast<derived *>(this)->compute_abs_diff(policy, arr, median, diff);
-
         /*
-         * Since the array is "half-sorted", we can abuse it:
-         * We start at the center, where we had the original median
-         * We then move outwards, comparing elements from the left and right halves
-         * We always pick the smaller of the two, move the corresponding pointer until we reach the new median
+         * Since the array is sorted, we can abuse it:
+         * The absolute differences grow from the center outwards, on the left and on the right side
+         * So the middle elements of the differences are the k-th smallest of two sorted sequences, found by binary search
+         * (no array of the differences needed at all)
          */
-        size_t left = diff.size() / 2 - 1, right = diff.size() / 2;
-        decimal prev = 0, curr = 0;
-        for (size_t i = 0; i <= diff.size() / 2; i++) {
-            prev = curr;
-            curr = diff[left] >= diff[right] ? diff[right++] : diff[left--];
-        }
+        const size_t k = arr.size() / 2;
+        const decimal curr = kth_abs_deviation(arr, median, k);
+        if (arr.size() & 1)
+            return curr;
+
+        const decimal prev = kth_abs_deviation(arr, median, k - 1);
+        return static_cast<decimal>((prev + curr) / 2.0);
+    }
+
+    /**
+     * Compute the mean absolute deviation of an array by selection (linear time, no sort)
+     * The middle elements of the array give the median, the middle elements of the absolute deviations give the MAD
+     * Both medians are computed from exactly the same elements as in the sorted path, so the results are the same
+     * The derived class may hide this function with its own (the GPU selects on the device)
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Any array -- unsorted (it is reordered by the selection)
+     * @param ws Workspace of the computation
+     * @return Mean absolute deviation
+     */
+    template <typename exec_policy>
+    [[nodiscard]] decimal compute_mad_select(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Select the middle elements for median calculation */
+        const auto [lower, upper] = static_cast<derived *>(this)->select(policy, arr, ws);
+
+        /* Get the median */
+        const auto median = static_cast<decimal>((upper + lower) / 2.0);
+
+        /* Calculate the absolute differences from the median (into the workspace) */
+        auto &diff = use_buffer(ws, ws.diff, arr.size());
+
+        static_cast<derived *>(this)->compute_abs_diff(policy, arr, median, diff, ws);
+
+        /* Select the middle elements of the differences -- their median is the MAD */
+        const auto [prev, curr] = static_cast<derived *>(this)->select(policy, diff, ws);
 
         return static_cast<decimal>((arr.size() & 1) ? curr : (prev + curr) / 2.0);
     }
 
+    /**
+     * Estimate the mean absolute deviation of an array by quantile sketches (no sort, no selection, the array is untouched)
+     * The first pass sketches the array and gives the median, the second one sketches the absolute deviations from it
+     * and gives the MAD -- the rank of both estimates is off by at most kll_sketch::rank_error(sketch_k) * n (99 %)
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Any array
+     * @param ws Workspace of the computation
+     * @return Approximate mean absolute deviation
+     */
+    template <typename exec_policy>
+    [[nodiscard]] decimal compute_mad_approx(exec_policy policy, const decimal_vector &arr, workspace &ws) {
+        /* Nothing to compute (the same result as the exact algorithms) */
+        if (arr.empty())
+            return 0;
+
+        /* Approximate median */
+        const decimal median = sketch_median(policy, arr, [](decimal val) { return val; }, this->options.sketch_k, ws);
+
+        /* Approximate median of the absolute differences from it */
+        return sketch_median(policy, arr, [median](decimal val) { return std::abs(val - median); }, this->options.sketch_k, ws);
+    }
+
+    /**
+     * Estimate the median of the transformed elements of the array -- every chunk (one per thread) builds its own
+     * sketch, the sketches are merged at the end (reduce); the sampler of the sketches reads only a part of the elements
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @tparam transform Function applied to every element before it is sketched (decimal(decimal))
+     * @param policy Execution policy
+     * @param arr Array
+     * @param fn Function applied to every element
+     * @param k Accuracy parameter of the sketches
+     * @param ws Workspace (sketches, chunk indices)
+     * @return Approximate median
+     */
+    template <typename exec_policy, typename transform>
+    [[nodiscard]] static decimal sketch_median(exec_policy policy, const decimal_vector &arr, transform fn, size_t k, workspace &ws) {
+        /* Prepare for parallelism */
+        const size_t max_num_threads = std::thread::hardware_concurrency();
+        const size_t chunk_size = arr.size() / max_num_threads;
+        auto &sketches = use_buffer(ws, ws.sketches, max_num_threads);
+        auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+        /* Sketch the chunks -- seeded by the chunk index, so the estimates are the same in every run */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &i) {
+            const size_t start = i * chunk_size;
+            /* Final thread may have to handle a little more elements */
+            const size_t end = (i == max_num_threads - 1) ? arr.size() : start + chunk_size;
+
+            sketches[i].reset(k, i);
+            sketches[i].update_range(arr.data() + start, end - start, fn);
+        });
+
+        /* Merge the sketches (reduce) */
+        for (size_t i = 1; i < max_num_threads; i++)
+            sketches[0].merge(sketches[i]);
+
+        return sketches[0].median();
+    }
+
     /**
      * Compute the coefficient of variance based on sum of X, sum of X^2 and number of elements
      * This function has to be implemented in here (.h), because of the template
@@ -64,13 +377,243 @@ public:
      * @return Coefficient of variance
      */
     template <typename exec_policy>
-    [[nodiscard]] decimal compute_coef_var(exec_policy policy, const std::vector<decimal> &arr) {
-        /* Using the formula: sqrt((sum of squares - sum^2 / n) / n) / (sum / n) */
-        const auto n = static_cast<double>(arr.size());
+    [[nodiscard]] decimal compute_coef_var(exec_policy policy, const decimal_vector &arr) {
+        decimal sum = 0, sum_sq = 0;
+        static_cast<derived *>(this)->compute_sums(policy, arr, sum, sum_sq, this->ws);
+
+        return coef_var_from_sums(sum, sum_sq, arr.size());
+    }
+
+    /**
+     * Compute the sums and sums of squares of several series in one pass -- every chunk (one per thread) sums its part of
+     * all the series, so a single fork / join covers all of them
+     * The chunks of each series are the same as if it was summed alone, so are the results
+     * The backend provides sum_range() (sums of one contiguous range) and chunk_alignment (in elements, of the chunk starts)
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @tparam series_function Function returning the series of the given index (const decimal_vector &(size_t))
+     * @param policy Execution policy
+     * @param num_series Number of series
+     * @param series_at Series of the given index
+     * @param sums Sums of the series (num_series elements, the sums are added to them)
+     * @param sums_sq Sums of squares of the series (num_series elements, the sums are added to them)
+     * @param ws Workspace of the computation
+     */
+    template <typename exec_policy, typename series_function>
+    void compute_sums_fused(exec_policy policy, size_t num_series, series_function series_at, decimal *sums, decimal *sums_sq, workspace &ws) {
+        /* Prepare for parallelism -- the partial sums of series s are at s * max_num_threads */
+        const size_t max_num_threads = std::thread::hardware_concurrency();
+        auto &partial_sums = use_buffer(ws, ws.partials[0], num_series * max_num_threads);
+        auto &partial_sums_sq = use_buffer(ws, ws.partials[1], num_series * max_num_threads);
+        std::fill(partial_sums.begin(), partial_sums.end(), 0);
+        std::fill(partial_sums_sq.begin(), partial_sums_sq.end(), 0);
+        auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+        /* Calculate the sums -- chunk i of every series */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &i) {
+            for (size_t s = 0; s < num_series; s++) {
+                const decimal_vector &arr = series_at(s);
+                auto chunk_size = arr.size() / max_num_threads;
+                chunk_size = chunk_size - chunk_size % derived::chunk_alignment;
+                const size_t start = i * chunk_size;
+                /* Final thread has to handle the rest */
+                const size_t end = (i == max_num_threads - 1) ? arr.size() : start + chunk_size;
+
+                static_cast<derived *>(this)->sum_range(arr.data() + start, end - start, partial_sums[s * max_num_threads + i], partial_sums_sq[s * max_num_threads + i]);
+            }
+        });
 
+        /* Combine the sums (reduce) */
+        for (size_t s = 0; s < num_series; s++) {
+            for (size_t i = 0; i < max_num_threads; i++) {
+                sums[s] += partial_sums[s * max_num_threads + i];
+                sums_sq[s] += partial_sums_sq[s * max_num_threads + i];
+            }
+        }
+    }
+
+    /**
+     * Compute the coefficients of variance and the mean absolute deviations of several series at once (X, Y and Z)
+     * The sums of all the series are computed in one fused pass (compute_sums_fused), then the MADs of the series run
+     * concurrently, each with its own workspace -- with the parallel policy, the sorts of small series no longer leave
+     * most of the threads idle
+     * Backends that cannot compute the series concurrently (concurrent_series is false -- the GPU has one queue and one
+     * input buffer) compute them one by one, exactly like compute_coef_var() and compute_mad()
+     * The results are the same as from compute_coef_var() and compute_mad() of each series
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param series Series -- unsorted (they are reordered by the MAD computation)
+     * @param coef_vars Coefficients of variance of the series (resized to the number of series)
+     * @param mads Mean absolute deviations of the series (resized to the number of series)
+     */
+    template <typename exec_policy>
+    void compute_series(exec_policy policy, std::vector<decimal_vector> &series, std::vector<decimal> &coef_vars, std::vector<decimal> &mads) {
+        const size_t num_series = series.size();
+        coef_vars.resize(num_series);
+        mads.resize(num_series);
+
+        if constexpr (!derived::concurrent_series) {
+            /* One by one -- order matters (CV -> MAD) */
+            for (size_t s = 0; s < num_series; s++) {
+                coef_vars[s] = this->compute_coef_var(policy, series[s]);
+                mads[s] = this->compute_mad(policy, series[s]);
+            }
+        } else {
+            /* One workspace per series (grown once, like the main one) */
+            if (this->series_ws.size() < num_series)
+                this->series_ws.resize(num_series);
+
+            /* Fused sums of all the series -- the outputs hold the sums until they are replaced by the results */
+            std::fill(coef_vars.begin(), coef_vars.end(), 0);
+            std::fill(mads.begin(), mads.end(), 0);
+            this->compute_sums_fused(policy, num_series, [&series](size_t s) -> const decimal_vector & { return series[s]; }, coef_vars.data(), mads.data(), this->ws);
+            for (size_t s = 0; s < num_series; s++)
+                coef_vars[s] = coef_var_from_sums(coef_vars[s], mads[s], series[s].size());
+
+            /* The MADs of the series concurrently (the chunk indices of the sums are not needed anymore) */
+            auto &series_indices = use_buffer(this->ws, this->ws.indices, num_series);
+            std::iota(series_indices.begin(), series_indices.end(), 0);
+            std::for_each(policy, series_indices.begin(), series_indices.end(), [&](const auto &s) {
+                mads[s] = this->compute_mad(policy, series[s], this->series_ws[s]);
+            });
+        }
+    }
+
+    /**
+     * Compute the coefficients of variance and the mean absolute deviations of the rolling window ending at every element
+     * of the array -- time series of both, in one call
+     * The elements are ranked once (sorted distinct values), then every chunk (one per thread) slides the window over its
+     * elements: the sums and sums of squares are updated by the entering and leaving elements (O(1)), their ranks are
+     * counted in a Fenwick tree (rank_tree, O(log u)) and the median and the MAD are read from the tree as from the sorted
+     * window (kth_abs_deviation) -- the MADs are the same as from compute_mad() of each window
+     * The CVs come from the rolling sums (added and subtracted), so they may differ from compute_coef_var() of each window
+     * in the last digits
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Array (column of the data) -- untouched
+     * @param times Timestamps of the elements, sorted (needed only if the window is given by time)
+     * @param window Window (number of samples or time span)
+     * @param coef_vars Coefficients of variance of the windows (resized to the size of the array)
+     * @param mads Mean absolute deviations of the windows (resized to the size of the array)
+     */
+    template <typename exec_policy>
+    void compute_rolling(exec_policy policy, const decimal_vector &arr, const std::vector<int64_t> &times, const rolling_window &window, std::vector<decimal> &coef_vars, std::vector<decimal> &mads) {
+        const size_t n = arr.size();
+        coef_vars.resize(n);
+        mads.resize(n);
+        if (!n)
+            return;
+
+        /* Not a part of any series (the copy below is not the array of the last sums) */
+        static_cast<derived *>(this)->end_series();
+
+        /* Distinct values of the array, sorted (a sorted copy in the workspace) */
+        auto &values = use_buffer(this->ws, this->ws.diff, n);
+        std::copy(policy, arr.begin(), arr.end(), values.begin());
+        static_cast<derived *>(this)->sort(policy, values, this->ws);
+        values.resize(static_cast<size_t>(std::unique(values.begin(), values.end()) - values.begin()));
+
+        /* Rank of every element (index of its value) */
+        auto &ranks = use_buffer(this->ws, this->ws.counters[0], n);
+        std::transform(policy, arr.begin(), arr.end(), ranks.begin(), [&values](const decimal val) {
+            return static_cast<size_t>(std::lower_bound(values.begin(), values.end(), val) - values.begin());
+        });
+
+        /* Prepare for parallelism */
+        const size_t max_num_threads = std::thread::hardware_concurrency();
+        const size_t chunk_size = n / max_num_threads;
+        auto &trees = use_buffer(this->ws, this->ws.trees, max_num_threads);
+        auto &chunk_indices = use_buffer(this->ws, this->ws.indices, max_num_threads);
+        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+        /* Slide the window over the chunks -- every chunk starts with the full window of its first element */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &i) {
+            const size_t start = i * chunk_size;
+            /* Final thread has to handle the rest */
+            const size_t end = (i == max_num_threads - 1) ? n : start + chunk_size;
+            if (start == end)
+                return;
+
+            auto &tree = trees[i];
+            tree.reset(values.size());
+            double sum = 0, sum_sq = 0;
+            const auto add = [&](const size_t row) {
+                tree.insert(ranks[row]);
+                sum += arr[row];
+                sum_sq += static_cast<double>(arr[row]) * arr[row];
+            };
+            const auto remove = [&](const size_t row) {
+                tree.erase(ranks[row]);
+                sum -= arr[row];
+                sum_sq -= static_cast<double>(arr[row]) * arr[row];
+            };
+
+            /* The i-th smallest element of the window */
+            const auto at = [&](const size_t k) { return values[tree.select(k)]; };
+
+            size_t first = window.first_row(times, start);
+            for (size_t row = first; row < start; row++)
+                add(row);
+
+            for (size_t row = start; row < end; row++) {
+                /* Move the window */
+                add(row);
+                const size_t new_first = window.advance(times, row, first);
+                for (; first < new_first; first++)
+                    remove(first);
+                const size_t count = tree.size();
+
+                /* Coefficient of variance -- the subtractions may leave the sum of squares a bit below its minimum */
+                const double min_sum_sq = sum * sum / static_cast<double>(count);
+                coef_vars[row] = coef_var_from_sums(static_cast<decimal>(sum), static_cast<decimal>(std::max(sum_sq, min_sum_sq)), count);
+
+                /* Median and MAD exactly like compute_mad() of the sorted window */
+                const auto median = static_cast<decimal>((at(count / 2) + at((count - 1) / 2)) / 2.0);
+                const size_t k = count / 2;
+                const decimal curr = kth_abs_deviation(count, at, median, k);
+                if (count & 1) {
+                    mads[row] = curr;
+                } else {
+                    const decimal prev = kth_abs_deviation(count, at, median, k - 1);
+                    mads[row] = static_cast<decimal>((prev + curr) / 2.0);
+                }
+            }
+        });
+    }
+
+    /**
+     * Extend the prefix of a series by the next elements and compute the coefficient of variance and the mean absolute
+     * deviation of the whole new prefix -- only the new elements are summed and sorted, then merged into the sorted prefix
+     * (O(c log c + m) instead of O((m + c) log (m + c)) of the full recompute, m = prefix, c = new elements)
+     * The MAD is the same as compute_mad() of the new prefix (sorted path); the CV comes from the sums of the parts, so it
+     * may differ from compute_coef_var() of the new prefix in the last digits
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param state State of the prefix (empty at first), extended by the new elements
+     * @param chunk New elements -- unsorted (it is sorted)
+     * @param coef_var Coefficient of variance of the new prefix
+     * @param mad Mean absolute deviation of the new prefix
+     */
+    template <typename exec_policy>
+    void extend_prefix(exec_policy policy, prefix_state &state, decimal_vector &chunk, decimal &coef_var, decimal &mad) {
+        /* Cumulative sums -- only the new elements are summed */
         decimal sum = 0, sum_sq = 0;
-        static_cast<derived *>(this)->compute_sums(policy, arr, sum, sum_sq);
+        static_cast<derived *>(this)->compute_sums(policy, chunk, sum, sum_sq, this->ws);
+        state.sum += sum;
+        state.sum_sq += sum_sq;
 
-        return static_cast<decimal>(std::sqrt((sum_sq - sum * sum / n) / n) / (sum / n));
+        /* Sort the new elements and merge them into the sorted prefix */
+        static_cast<derived *>(this)->sort(policy, chunk, this->ws);
+        static_cast<derived *>(this)->end_series();
+        state.merged.resize(state.sorted.size() + chunk.size());
+        std::merge(policy, state.sorted.begin(), state.sorted.end(), chunk.begin(), chunk.end(), state.merged.begin());
+        state.sorted.swap(state.merged);
+
+        coef_var = coef_var_from_sums(state.sum, state.sum_sq, state.sorted.size());
+        mad = state.sorted.empty() ? 0 : mad_of_sorted(state.sorted);
     }
-};
\ No newline at end of file
+};
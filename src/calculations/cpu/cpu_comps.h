@@ -3,10 +3,14 @@
 #include <vector>
 
 #include <execution>
-#include <immintrin.h>
 
 #include "calculations/computations.h"
 #include "calculations/cpu/merge_sort.h"
+#include "calculations/cpu/radix_sort.h"
+#include "calculations/cpu/sample_sort.h"
+#include "calculations/cpu/simd_sort.h"
+#include "calculations/selection.h"
+#include "simd/simd_kernels.h"
 #include "utils/utils.h"
 
 /* This, and the arg parser, are the only files where I found OOP to be useful */
@@ -19,18 +23,41 @@
 class seq_comp : public computations<seq_comp> {
 public:
     /**
-     * Wrapper function around the merge sort from the merge_sort.h file
+     * Wrapper function around the merge sort from the merge_sort.h file (or the radix sort from the radix_sort.h file,
+     * or the sample sort from the sample_sort.h file)
      * This is here purely for the static polymorphism to work with the GPU computations
      * This is an actual implementation of the "abstract" function in the base class
      * This function has to be implemented in here (.h), because of the template
      * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
      * @param policy Execution policy
      * @param arr Array
+     * @param ws Workspace of the computation
      */
     template<typename exec_policy>
-    static void sort(exec_policy policy, std::vector<decimal> &arr) {
-        /* Call the merge sort */
-        merge_sort(policy, arr);
+    void sort(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Call the chosen sort (--sort flag) */
+        if (this->options.sort == sort_algorithm::radix)
+            radix_sort(policy, arr, ws);
+        else if (this->options.sort == sort_algorithm::sample)
+            sample_sort(policy, arr, merge_sort_range, ws);
+        else
+            merge_sort(policy, arr, ws);
+    }
+
+    /**
+     * Wrapper function around the selection from the selection.h file
+     * This is an actual implementation of the "abstract" function in the base class
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Array (it is reordered by the selection)
+     * @param ws Workspace of the computation
+     * @return Lower and upper middle element of the array
+     */
+    template<typename exec_policy>
+    std::pair<decimal, decimal> select(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Call the selection (introselect, or the parallel quickselect) */
+        return select_middle(policy, arr, ws);
     }
 
     /**
@@ -41,10 +68,13 @@ public:
      * @param policy Execution policy
      * @param arr Array
      * @param median Median of the array
+     * @param ws Workspace of the computation (unused, no scratch buffers needed)
      * @return Absolute difference between each element and the median
      */
     template<typename exec_policy>
-    static void compute_abs_diff(exec_policy policy, const std::vector<decimal> &arr, decimal median, std::vector<decimal> &diff) {
+    static void compute_abs_diff(exec_policy policy, const decimal_vector &arr, decimal median, decimal_vector &diff, workspace &ws) {
+        (void) ws;  /* Supress warning about unused workspace */
+
         /* Calculate the absolute differences from the median */
         std::for_each(policy, arr.begin(), arr.end(), [&](const auto &val) {
             /* Trick: &val - &arr[0] gives the index of the element */
@@ -52,6 +82,11 @@ public:
         });
     }
 
+    /** Elements the chunks of the sums are aligned to (none) */
+    static constexpr size_t chunk_alignment = 1;
+    /** The series can be computed concurrently (compute_series) */
+    static constexpr bool concurrent_series = true;
+
     /**
      * Compute the sum and sum of squares of the array elements in a sequential manner
      * This is an actual implementation of the "abstract" function in the base class
@@ -61,58 +96,79 @@ public:
      * @param arr Array
      * @param sum Sum of the array elements
      * @param sum_sq Sum of squares of the array elements
+     * @param ws Workspace of the computation
      */
     template<typename exec_policy>
-    static void compute_sums(exec_policy policy, const std::vector<decimal> &arr, decimal &sum, decimal &sum_sq) {
-        /* Prepare for parallelism */
-        const auto max_num_threads = std::thread::hardware_concurrency();
-        const auto chunk_size = arr.size() / max_num_threads;
-        std::vector<decimal> sums(max_num_threads, 0);
-        std::vector<decimal> sums_sq(max_num_threads, 0);
-        std::vector<size_t> chunk_indices(max_num_threads);
-        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
-
-        /* Calculate the sums */
-        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &i) {
-            const size_t start = i * chunk_size;
-            /* Final thread may have to handle a little more elements */
-            const size_t end = (i == max_num_threads - 1) ? arr.size() : start + chunk_size;
-
-            /* Calculate the sum and sum of squares */
-            for (size_t j = start; j < end; j++) {
-                sums[i] += arr[j];
-                sums_sq[i] += arr[j] * arr[j];
-            }
-        });
+    void compute_sums(exec_policy policy, const decimal_vector &arr, decimal &sum, decimal &sum_sq, workspace &ws) {
+        /* The fused pass of the base class with a single series */
+        this->compute_sums_fused(policy, 1, [&arr](size_t) -> const decimal_vector & { return arr; }, &sum, &sum_sq, ws);
+    }
 
-        /* Combine the sums (reduce) */
-        for (size_t i = 0; i < max_num_threads; i++) {
-            sum += sums[i];
-            sum_sq += sums_sq[i];
+    /**
+     * Add the sum and sum of squares of a range to the given sums in a sequential manner (one chunk of compute_sums_fused)
+     * @param arr Start of the range
+     * @param n Number of elements
+     * @param sum Sum the range is added to
+     * @param sum_sq Sum of squares the range is added to
+     */
+    static void sum_range(const decimal *arr, size_t n, decimal &sum, decimal &sum_sq) {
+        for (size_t j = 0; j < n; j++) {
+            sum += arr[j];
+            sum_sq += arr[j] * arr[j];
         }
     }
 };
 
 /**
  * Vectorized computation class
- * Defines the computation of absolute difference and sums in a vectorized manner
+ * Defines the computation of absolute difference and sums in a vectorized manner -- by the kernels of the instruction
+ * set chosen in the options (the best one supported by the CPU by default, --isa flag)
  * Uses the static polymorphism technique (CRTP (Curiously Recurring Template Pattern)) to define the interface
  */
 class vec_comp : public computations<vec_comp> {
 public:
     /**
-     * Wrapper function around the merge sort from the merge_sort.h file
+     * Wrapper function around the vectorized merge sort from the simd_sort.h file (or the radix sort from the
+     * radix_sort.h file, or the sample sort from the sample_sort.h file with the vectorized merge sort of the buckets)
      * This is here purely for the static polymorphism to work with the GPU computations
      * This is an actual implementation of the "abstract" function in the base class
      * This function has to be implemented in here (.h), because of the template
      * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
      * @param policy Execution policy
      * @param arr Array
+     * @param ws Workspace of the computation
+     */
+    template<typename exec_policy>
+    void sort(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        const auto &kernels = get_simd_kernels(this->options.isa);
+
+        /* Call the chosen sort (--sort flag) */
+        if (this->options.sort == sort_algorithm::radix) {
+            radix_sort(policy, arr, ws);
+        } else if (this->options.sort == sort_algorithm::sample) {
+            const auto bucket_sort = [&kernels](decimal *bucket, decimal *buffer, size_t n) {
+                simd_merge_sort_range(bucket, buffer, n, kernels);
+            };
+            sample_sort(policy, arr, bucket_sort, ws);
+        } else {
+            simd_merge_sort(policy, arr, ws, kernels);
+        }
+    }
+
+    /**
+     * Wrapper function around the selection from the selection.h file
+     * This is an actual implementation of the "abstract" function in the base class
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy
+     * @param arr Array (it is reordered by the selection)
+     * @param ws Workspace of the computation
+     * @return Lower and upper middle element of the array
      */
     template<typename exec_policy>
-    static void sort(exec_policy policy, std::vector<decimal> &arr) {
-        /* Call the merge sort */
-        merge_sort(policy, arr);
+    std::pair<decimal, decimal> select(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Call the selection (introselect, or the parallel quickselect) */
+        return select_middle(policy, arr, ws);
     }
 
     /**
@@ -123,65 +179,36 @@ public:
      * @param policy Execution policy
      * @param arr Array
      * @param median Median of the array
+     * @param ws Workspace of the computation
      * @return Absolute difference between each element and the median
      */
     template<typename exec_policy>
-    static void compute_abs_diff(exec_policy policy, const std::vector<decimal> &arr, decimal median, std::vector<decimal> &diff) {
+    void compute_abs_diff(exec_policy policy, const decimal_vector &arr, decimal median, decimal_vector &diff, workspace &ws) {
+        const auto &kernels = get_simd_kernels(this->options.isa);
         const size_t n = arr.size();
 
-        /* How many decimals can be processed at once */
-        #ifndef _USE_FLOAT
-        const size_t vec_capacity = sizeof(__m256d) / sizeof(decimal);
-        #else
-        const size_t vec_capacity = sizeof(__m256) / sizeof(decimal);
-        #endif
-
-        /* Load the median into an AVX2 register */
-        #ifndef _USE_FLOAT
-        __m256d median_vec = _mm256_set1_pd(median);
-        #else
-        __m256 median_vec = _mm256_set1_ps(median);
-        #endif
-
-        /* Prepare for parallelism */
-        std::vector<size_t> indices(n / vec_capacity);
-        for (size_t i = 0; i < indices.size(); i++)
-            indices[i] = i * vec_capacity;
-
-        /* Process 4 doubles at a time */
-        std::for_each(policy, indices.begin(), indices.end(), [&](const auto &i) {
-            #ifndef _USE_FLOAT
-            /* Load 4 doubles into an AVX2 register */
-            __m256d arr_vec = _mm256_loadu_pd(&arr[i]);
-
-            /* Subtract the median from the array */
-            __m256d diff_vec = _mm256_sub_pd(arr_vec, median_vec);
-            /* Absolute value */
-            __m256d sign_bit = _mm256_set1_pd(-0.0);
-            diff_vec = _mm256_andnot_pd(sign_bit, diff_vec);
-
-            /* Store the result */
-            _mm256_storeu_pd(&diff[i], diff_vec);
-            #else
-            /* Load 8 floats into an AVX2 register */
-            __m256 arr_vec = _mm256_loadu_ps(&arr[i]);
+        /* Prepare for parallelism -- one chunk per thread, every chunk starts aligned (for the aligned loads) */
+        const auto max_num_threads = std::thread::hardware_concurrency();
+        auto chunk_size = n / max_num_threads;
+        chunk_size = chunk_size - chunk_size % (simd_alignment / sizeof(decimal));
+        auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
 
-            /* Subtract the median from the array */
-            __m256 diff_vec = _mm256_sub_ps(arr_vec, median_vec);
-            /* Absolute value */
-            __m256 sign_bit = _mm256_set1_ps(-0.0);
-            diff_vec = _mm256_andnot_ps(sign_bit, diff_vec);
+        /* Calculate the absolute differences, chunk by chunk */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &chunk) {
+            const size_t start = chunk * chunk_size;
+            /* Final thread has to handle the rest (the kernel handles the elements that do not fill a register) */
+            const size_t end = (chunk == max_num_threads - 1) ? n : start + chunk_size;
 
-            /* Store the result */
-            _mm256_storeu_ps(&diff[i], diff_vec);
-            #endif
+            kernels.abs_diff(arr.data() + start, end - start, median, diff.data() + start);
         });
-
-        /* Handle the remaining elements (if array size is not a multiple of 4) */
-        for (size_t i = n - n % vec_capacity; i < n; i++)
-            diff[i] = std::abs(arr[i] - median);
     }
 
+    /** Elements the chunks of the sums are aligned to (for the aligned loads) */
+    static constexpr size_t chunk_alignment = simd_alignment / sizeof(decimal);
+    /** The series can be computed concurrently (compute_series) */
+    static constexpr bool concurrent_series = true;
+
     /**
      * Compute the sum and sum of squares of the array elements in a vectorized manner
      * This is an actual implementation of the "abstract" function in the base class
@@ -191,90 +218,22 @@ public:
      * @param arr Array
      * @param sum Sum of the array elements
      * @param sum_sq Sum of squares of the array elements
+     * @param ws Workspace of the computation
      */
     template<typename exec_policy>
-    static void compute_sums(exec_policy policy, const std::vector<decimal> &arr, decimal &sum, decimal &sum_sq) {
-        const size_t n = arr.size();
-
-        /* How many decimals can be processed at once */
-        #ifndef _USE_FLOAT
-        const size_t vec_capacity = sizeof(__m256d) / sizeof(decimal);
-        #else
-        const size_t vec_capacity = sizeof(__m256) / sizeof(decimal);
-        #endif
-
-        /* Prepare for parallelism */
-        const auto max_num_threads = std::thread::hardware_concurrency();
-        auto chunk_size = arr.size() / max_num_threads;
-        /* Make sure that chunk_size is a multiple of 4 */
-        chunk_size = chunk_size - chunk_size % vec_capacity;
-        std::vector<decimal> sums(max_num_threads, 0);
-        std::vector<decimal> sums_sq(max_num_threads, 0);
-        std::vector<size_t> chunk_indices(max_num_threads);
-        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
-
-        /* Calculate the sums */
-        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto &i) {
-            const size_t start = i * chunk_size;
-            /* Here we are sure that chunk_size is a multiple of 4, so last thread does not have to handle more work */
-            const size_t end = start + chunk_size;
-
-            /* Initialize an AVX2 register for sums with zeros */
-            #ifndef _USE_FLOAT
-            __m256d sum_vec = _mm256_setzero_pd();
-            __m256d sum_sq_vec = _mm256_setzero_pd();
-            #else
-            __m256 sum_vec = _mm256_setzero_ps();
-            __m256 sum_sq_vec = _mm256_setzero_ps();
-            #endif
-
-            /* Process 4 doubles at a time */
-            for (size_t j = start; j < end; j += vec_capacity) {
-                #ifndef _USE_FLOAT
-                /* Load 4 doubles into an AVX2 register */
-                __m256d arr_vec = _mm256_loadu_pd(&arr[j]);
-
-                /* Compute the sums */
-                sum_vec = _mm256_add_pd(sum_vec, arr_vec);
-                sum_sq_vec = _mm256_add_pd(sum_sq_vec, _mm256_mul_pd(arr_vec, arr_vec));
-                #else
-                /* Load 8 floats into an AVX2 register */
-                __m256 arr_vec = _mm256_loadu_ps(&arr[j]);
-
-                /* Compute the sums */
-                sum_vec = _mm256_add_ps(sum_vec, arr_vec);
-                sum_sq_vec = _mm256_add_ps(sum_sq_vec, _mm256_mul_ps(arr_vec, arr_vec));
-                #endif
-            }
-
-            /* Extract the sums from the AVX2 registers */
-            std::vector<decimal> sum_arr(vec_capacity, 0.0);
-            std::vector<decimal> sum_sq_arr(vec_capacity, 0.0);
-            #ifndef _USE_FLOAT
-            _mm256_storeu_pd(sum_arr.data(), sum_vec);
-            _mm256_storeu_pd(sum_sq_arr.data(), sum_sq_vec);
-            #else
-            _mm256_storeu_ps(sum_arr.data(), sum_vec);
-            _mm256_storeu_ps(sum_sq_arr.data(), sum_sq_vec);
-            #endif
-
-            /* Combine the sums */
-            for (size_t j = 0; j < vec_capacity; j++) {
-                sums[i] += sum_arr[j];
-                sums_sq[i] += sum_sq_arr[j];
-            }
-        });
-
-        /* Combine the sums */
-        for (size_t i = 0; i < max_num_threads; i++) {
-            sum += sums[i];
-            sum_sq += sums_sq[i];
-        }
+    void compute_sums(exec_policy policy, const decimal_vector &arr, decimal &sum, decimal &sum_sq, workspace &ws) {
+        /* The fused pass of the base class with a single series */
+        this->compute_sums_fused(policy, 1, [&arr](size_t) -> const decimal_vector & { return arr; }, &sum, &sum_sq, ws);
+    }
 
-        /* Handle the remaining elements (if array size or chunk size were not a multiple of 4) */
-        for (size_t i = chunk_size * max_num_threads; i < n; i++) {
-            sum += arr[i];
-            sum_sq += arr[i] * arr[i];
-        }
+    /**
+     * Add the sum and sum of squares of a range to the given sums in a vectorized manner (one chunk of compute_sums_fused)
+     * @param arr Start of the range (aligned)
+     * @param n Number of elements (the kernel handles the elements that do not fill a register)
+     * @param sum Sum the range is added to
+     * @param sum_sq Sum of squares the range is added to
+     */
+    void sum_range(const decimal *arr, size_t n, decimal &sum, decimal &sum_sq) const {
+        get_simd_kernels(this->options.isa).sums(arr, n, sum, sum_sq);
     }
 };
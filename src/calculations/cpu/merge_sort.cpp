@@ -1,21 +1,50 @@
 #include "calculations/cpu/merge_sort.h"
 
-void merge(std::vector<decimal> &arr, const size_t left, const size_t mid, const size_t right) {
-    const size_t n1 = mid - left + 1;
-    const size_t n2 = right - mid;
+void merge(const decimal *a, const size_t na, const decimal *b, const size_t nb, decimal *out) {
+    /* Actual merge */
+    size_t i = 0, j = 0;
+    while (i < na && j < nb)
+        *out++ = a[i] <= b[j] ? a[i++] : b[j++];
 
-    /* Temporary arrays to hold the left and right halves */
-    std::vector<decimal> leftArr(arr.begin() + static_cast<int>(left), arr.begin() + static_cast<int>(mid) + 1);
-    std::vector<decimal> rightArr(arr.begin() + static_cast<int>(mid) + 1, arr.begin() + static_cast<int>(right) + 1);
+    /* Copy any remaining elements from either of the arrays */
+    out = std::copy(a + i, a + na, out);
+    std::copy(b + j, b + nb, out);
+}
 
-    /* Actual merge */
-    size_t i = 0, j = 0, k = left;
-    while (i < n1 && j < n2)
-        arr[k++] = leftArr[i] <= rightArr[j] ? leftArr[i++] : rightArr[j++];
+size_t merge_path_split(const decimal *a, const size_t na, const decimal *b, const size_t nb, const size_t diag) {
+    /* Whole runs -- no search needed (the common case on the lower levels) */
+    if (diag == 0)
+        return 0;
+    if (diag == na + nb)
+        return na;
+
+    /* Binary search on the diagonal -- a[mid] is in the output iff it is not greater than b[diag - mid - 1] */
+    size_t low = diag > nb ? diag - nb : 0;
+    size_t high = std::min(diag, na);
+    while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (a[mid] <= b[diag - mid - 1])
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void merge_sort_range(decimal *arr, decimal *buffer, const size_t n) {
+    /* For each subarray size (bottom up approach), from src to dst */
+    decimal *src = arr;
+    decimal *dst = buffer;
+    for (size_t size = 1; size < n; size *= 2) {
+        for (size_t left = 0; left < n; left += 2 * size) {
+            const size_t mid = std::min(left + size, n);
+            const size_t right = std::min(left + 2 * size, n);
+            merge(src + left, mid - left, src + mid, right - mid, dst + left);
+        }
+        std::swap(src, dst);
+    }
 
-    /* Copy any remaining elements from either of the halves */
-    while (i < n1)
-        arr[k++] = leftArr[i++];
-    while (j < n2)
-        arr[k++] = rightArr[j++];
+    /* Odd number of levels -- the sorted numbers are in the buffer */
+    if (src != arr)
+        std::copy(src, src + n, arr);
 }
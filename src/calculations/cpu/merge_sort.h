@@ -2,46 +2,128 @@
 
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <thread>
 
 #include <execution>
 
+#include "calculations/workspace.h"
 #include "utils/utils.h"
 
+/*
+ * Bottom-up merge sort without allocations in the merges
+ * One scratch buffer is allocated up front, every level merges from the source to the destination and then they swap
+ * Each level is split evenly across the threads by the output position (merge path) -- a thread takes its part of the
+ * output, finds where that part starts and ends in both runs by a binary search and merges only that, so even the last
+ * levels (one or two big merges) use all the threads
+ */
+
 /**
  * Merge function
- * Merges two sorted arrays (left and right half)
- * If final_merge is true, calculates the sum and sum of squares of the array elements
- * @param arr Array to be sorted
- * @param left Left index of the subarray
- * @param mid Middle index of the subarray
- * @param right Right index of the subarray
+ * Merges two sorted arrays into the output (stable -- equal elements are taken from the first array first)
+ * @param a First sorted array
+ * @param na Number of elements of the first array
+ * @param b Second sorted array
+ * @param nb Number of elements of the second array
+ * @param out Output (na + nb elements, must not overlap with the inputs)
+ */
+void merge(const decimal *a, size_t na, const decimal *b, size_t nb, decimal *out);
+
+/**
+ * Merge path partitioning
+ * Finds how many elements of the first array are among the first diag elements of the (stable) merged output
+ * @param a First sorted array
+ * @param na Number of elements of the first array
+ * @param b Second sorted array
+ * @param nb Number of elements of the second array
+ * @param diag Number of elements of the merged output (diag <= na + nb)
+ * @return Number of elements taken from the first array (the rest, diag - result, is taken from the second one)
+ */
+size_t merge_path_split(const decimal *a, size_t na, const decimal *b, size_t nb, size_t diag);
+
+/**
+ * Sequential merge sort of a range (stable, no allocations -- the merges alternate between the range and the buffer)
+ * @param arr Range to be sorted
+ * @param buffer Scratch buffer of at least n elements (must not overlap with the range)
+ * @param n Number of elements
+ */
+void merge_sort_range(decimal *arr, decimal *buffer, size_t n);
+
+/**
+ * One level of the bottom-up merge sort -- merges pairs of sorted runs of the given size from src into dst
+ * Every chunk (thread) merges an equal part of the output, split by the merge path
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @tparam merge_function Function merging two sorted arrays, the same signature as merge()
+ * @param policy Execution policy
+ * @param chunk_indices Indices of the chunks (0 ... number of threads - 1)
+ * @param src Sorted runs of the given size (the last one may be shorter)
+ * @param dst Output -- sorted runs of twice the size
+ * @param n Number of elements
+ * @param size Size of the runs
+ * @param merge_runs Merge function
  */
-void merge(std::vector<decimal> &arr, size_t left, size_t mid, size_t right);
+template <typename exec_policy, typename merge_function>
+void merge_level(exec_policy policy, const std::vector<size_t> &chunk_indices, const decimal *src, decimal *dst, size_t n,
+                 size_t size, merge_function merge_runs) {
+    const size_t num_chunks = chunk_indices.size();
+
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        /* Part of the output of this chunk */
+        const size_t start = i * n / num_chunks;
+        const size_t end = (i + 1) * n / num_chunks;
+
+        /* For each pair of runs overlapping the part -- merge only the overlapping piece of the pair */
+        for (size_t pos = start; pos < end;) {
+            const size_t left = pos / (2 * size) * (2 * size);
+            const size_t mid = std::min(left + size, n);
+            const size_t right = std::min(left + 2 * size, n);
+            const size_t piece_end = std::min(end, right);
+
+            /* Where the piece starts and ends in both runs */
+            const size_t a_start = merge_path_split(src + left, mid - left, src + mid, right - mid, pos - left);
+            const size_t a_end = merge_path_split(src + left, mid - left, src + mid, right - mid, piece_end - left);
+            const size_t b_start = pos - left - a_start;
+            const size_t b_end = piece_end - left - a_end;
+
+            merge_runs(src + left + a_start, a_end - a_start, src + mid + b_start, b_end - b_start, dst + pos);
+            pos = piece_end;
+        }
+    });
+}
 
 /**
  * Modified merge sort function
- * Sorts the array and calculates the sum and sum of squares of the array elements
+ * Sorts the array (stable), one scratch buffer (from the workspace) for the whole sort
  * This function has to be implemented in here (.h), because of the template
  * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
  * @param policy Execution policy
- * @param arr Array to be sorted
+ * @param arr Array to be sorted (its buffer may be swapped with the scratch buffer)
+ * @param ws Workspace (scratch buffer, chunk indices)
+ * @param num_threads Number of chunks (threads) of each level (0 = hardware_concurrency())
  */
 template <typename exec_policy>
-void merge_sort(exec_policy policy, std::vector<decimal> &arr) {
-    /* For each subarray size, basically a stride (bottom up approach) */
-    for (size_t size = 1; size < arr.size(); size *= 2) {
-        /* Prepare indices for std::for_each */
-        std::vector<size_t> indices;
-        for (size_t left = 0; left < arr.size(); left += 2 * size)
-            indices.push_back(left);
-
-        /* For each pair of sub-arrays -- left and right -- sort and merge them */
-        std::for_each(policy, indices.begin(), indices.end(), [&](const auto left) {
-            const size_t mid = std::min(left + size - 1, arr.size() - 1);
-            const size_t right = std::min(left + 2 * size - 1, arr.size() - 1);
-
-            /* Sort and merge the pair */
-            merge(arr, left, mid, right);
-        });
+void merge_sort(exec_policy policy, decimal_vector &arr, workspace &ws, size_t num_threads = 0) {
+    const size_t n = arr.size();
+    if (n < 2)
+        return;
+
+    /* Prepare for parallelism */
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    auto &chunk_indices = use_buffer(ws, ws.indices, num_threads);
+    std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+    /* For each subarray size, basically a stride (bottom up approach), from src to dst */
+    auto &scratch = use_buffer(ws, ws.scratch, n);
+    decimal *src = arr.data();
+    decimal *dst = scratch.data();
+    for (size_t size = 1; size < n; size *= 2) {
+        merge_level(policy, chunk_indices, src, dst, n, size, merge);
+        std::swap(src, dst);
     }
+
+    /* Odd number of levels -- the sorted numbers are in the scratch buffer */
+    if (src != arr.data())
+        arr.swap(scratch);
 }
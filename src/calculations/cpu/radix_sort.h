@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include <execution>
+
+#include "calculations/workspace.h"
+#include "utils/utils.h"
+
+/*
+ * LSD radix sort of the decimals
+ * The bits of a float / double are mapped to an unsigned key with the same order (negative numbers have all the bits
+ * flipped, positive numbers only the sign bit), then the keys are sorted 8 bits at a time, from the lowest byte up
+ * Each pass is parallel -- every thread counts the digits of its chunk (per-thread histogram), the prefix sums over
+ * (digit, thread) give every thread its own output offsets and the threads scatter their chunks (stable)
+ * Passes where all the numbers share the same digit are skipped (common for the high bytes of the data)
+ */
+
+#ifndef _USE_FLOAT
+/** Unsigned key of the same size as decimal */
+using radix_key = uint64_t;
+#else
+/** Unsigned key of the same size as decimal */
+using radix_key = uint32_t;
+#endif
+
+/** Number of bits sorted in one pass */
+constexpr size_t radix_bits = 8;
+/** Number of buckets (digits) of one pass */
+constexpr size_t radix_buckets = 1 << radix_bits;
+/** Number of passes (bytes of the key) */
+constexpr size_t radix_passes = sizeof(radix_key) * 8 / radix_bits;
+
+/**
+ * Map the decimal to an unsigned key with the same order (IEEE-754 bits)
+ * -0.0 is mapped to the key of 0.0, so that the equal numbers stay in their order (the same output as the merge sort)
+ * @param value Number
+ * @return Order preserving key
+ */
+inline radix_key to_radix_key(decimal value) {
+    constexpr radix_key sign_bit = static_cast<radix_key>(1) << (sizeof(radix_key) * 8 - 1);
+
+    radix_key bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits == sign_bit)
+        bits = 0;
+    return (bits & sign_bit) ? ~bits : bits | sign_bit;
+}
+
+/**
+ * Parallel LSD radix sort (ascending, stable)
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param arr Array to be sorted (its buffer may be swapped with the scratch buffer)
+ * @param ws Workspace (scratch buffer, chunk indices, histograms)
+ */
+template <typename exec_policy>
+void radix_sort(exec_policy policy, decimal_vector &arr, workspace &ws) {
+    const size_t n = arr.size();
+    if (n < 2)
+        return;
+
+    /* Prepare for parallelism */
+    const auto max_num_threads = std::thread::hardware_concurrency();
+    const size_t chunk_size = n / max_num_threads;
+    auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+    std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+    /* Histograms of all the digits at once -- only to find the passes that can be skipped */
+    auto &digit_counts = use_buffer(ws, ws.counters[0], max_num_threads * radix_passes * radix_buckets);
+    std::fill(digit_counts.begin(), digit_counts.end(), 0);
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const size_t start = i * chunk_size;
+        /* Final thread may have to handle a little more elements */
+        const size_t end = (i == max_num_threads - 1) ? n : start + chunk_size;
+
+        size_t *counts = &digit_counts[i * radix_passes * radix_buckets];
+        for (size_t j = start; j < end; j++) {
+            const radix_key key = to_radix_key(arr[j]);
+            for (size_t pass = 0; pass < radix_passes; pass++)
+                counts[pass * radix_buckets + ((key >> (pass * radix_bits)) & (radix_buckets - 1))]++;
+        }
+    });
+
+    /* Scratch buffer and the per-thread histograms (offsets) of one pass */
+    auto &scratch = use_buffer(ws, ws.scratch, n);
+    decimal *src = arr.data();
+    decimal *dst = scratch.data();
+    auto &offsets = use_buffer(ws, ws.counters[1], max_num_threads * radix_buckets);
+
+    for (size_t pass = 0; pass < radix_passes; pass++) {
+        /* Skip the pass if all the numbers have the same digit */
+        bool trivial = false;
+        for (size_t digit = 0; digit < radix_buckets && !trivial; digit++) {
+            size_t count = 0;
+            for (size_t i = 0; i < max_num_threads; i++)
+                count += digit_counts[(i * radix_passes + pass) * radix_buckets + digit];
+            trivial = count == n;
+        }
+        if (trivial)
+            continue;
+
+        const size_t shift = pass * radix_bits;
+
+        /* Per-thread histograms of the current order */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+            const size_t start = i * chunk_size;
+            const size_t end = (i == max_num_threads - 1) ? n : start + chunk_size;
+
+            size_t *counts = &offsets[i * radix_buckets];
+            std::fill(counts, counts + radix_buckets, 0);
+            for (size_t j = start; j < end; j++)
+                counts[(to_radix_key(src[j]) >> shift) & (radix_buckets - 1)]++;
+        });
+
+        /* Exclusive prefix sum over (digit, thread) -- thread i writes digit d right after the threads before it */
+        size_t offset = 0;
+        for (size_t digit = 0; digit < radix_buckets; digit++)
+            for (size_t i = 0; i < max_num_threads; i++) {
+                const size_t count = offsets[i * radix_buckets + digit];
+                offsets[i * radix_buckets + digit] = offset;
+                offset += count;
+            }
+
+        /* Scatter -- every thread has its own output positions, no synchronization needed */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+            const size_t start = i * chunk_size;
+            const size_t end = (i == max_num_threads - 1) ? n : start + chunk_size;
+
+            size_t *positions = &offsets[i * radix_buckets];
+            for (size_t j = start; j < end; j++)
+                dst[positions[(to_radix_key(src[j]) >> shift) & (radix_buckets - 1)]++] = src[j];
+        });
+
+        std::swap(src, dst);
+    }
+
+    /* Odd number of passes -- the sorted numbers are in the scratch buffer */
+    if (src != arr.data())
+        arr.swap(scratch);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+#include <execution>
+
+#include "calculations/workspace.h"
+#include "utils/utils.h"
+
+/*
+ * Parallel sample sort
+ * 1) Splitters -- an evenly spaced sample (oversampled per bucket) is sorted, every oversampling-th element is a splitter
+ * 2) One parallel partition -- every thread counts the buckets of the elements in its chunk, the prefix sums over
+ *    (bucket, thread) give every thread its own output offsets and the threads scatter their chunks (stable)
+ * 3) Every bucket is sorted locally by one thread with the given (sequential) sort
+ * Unlike the merge sort, there are no levels where the parallelism collapses -- one pass over the data, then the threads
+ * work on independent buckets
+ */
+
+/** Below this number of elements, the whole array is sorted by the local sort only */
+constexpr size_t sample_sort_threshold = 1 << 16;
+/** Number of sampled elements per bucket (more = more even buckets) */
+constexpr size_t sample_oversampling = 32;
+
+/**
+ * Parallel sample sort (ascending, stable if the local sort is stable)
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @tparam bucket_sort_function Sequential sort of a range -- void(decimal *arr, decimal *buffer, size_t n), like
+ *                              merge_sort_range() or simd_merge_sort_range() bound to the kernels
+ * @param policy Execution policy
+ * @param arr Array to be sorted (its buffer may be swapped with the scratch buffer)
+ * @param bucket_sort Local sort of the buckets
+ * @param ws Workspace (scratch buffer, sample, chunk indices, histograms)
+ * @param num_threads Number of chunks and buckets (threads) (0 = hardware_concurrency())
+ */
+template <typename exec_policy, typename bucket_sort_function>
+void sample_sort(exec_policy policy, decimal_vector &arr, bucket_sort_function bucket_sort, workspace &ws, size_t num_threads = 0) {
+    const size_t n = arr.size();
+    if (n < 2)
+        return;
+
+    if (num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    auto &scratch = use_buffer(ws, ws.scratch, n);
+
+    /* Not worth the partition -- just the local sort */
+    if (num_threads == 1 || n < sample_sort_threshold) {
+        bucket_sort(arr.data(), scratch.data(), n);
+        return;
+    }
+
+    /* Splitters from the sorted sample -- bucket b gets the elements in [splitters[b - 1], splitters[b]) */
+    const size_t num_buckets = num_threads;
+    auto &sample = use_buffer(ws, ws.partials[0], num_buckets * sample_oversampling);
+    for (size_t i = 0; i < sample.size(); i++)
+        sample[i] = arr[i * (n - 1) / (sample.size() - 1)];
+    std::sort(sample.begin(), sample.end());
+    auto &splitters = use_buffer(ws, ws.partials[1], num_buckets - 1);
+    for (size_t b = 1; b < num_buckets; b++)
+        splitters[b - 1] = sample[b * sample_oversampling];
+
+    const auto bucket_of = [&](const decimal val) {
+        return static_cast<size_t>(std::upper_bound(splitters.begin(), splitters.end(), val) - splitters.begin());
+    };
+
+    /* Prepare for parallelism */
+    const size_t chunk_size = n / num_threads;
+    auto &chunk_indices = use_buffer(ws, ws.indices, num_threads);
+    std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+    auto &offsets = use_buffer(ws, ws.counters[0], num_threads * num_buckets);
+
+    /* Per-thread histograms of the buckets */
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const size_t start = i * chunk_size;
+        /* Final thread may have to handle a little more elements */
+        const size_t end = (i == num_threads - 1) ? n : start + chunk_size;
+
+        size_t *counts = &offsets[i * num_buckets];
+        std::fill(counts, counts + num_buckets, 0);
+        for (size_t j = start; j < end; j++)
+            counts[bucket_of(arr[j])]++;
+    });
+
+    /* Exclusive prefix sum over (bucket, thread) -- thread i writes bucket b right after the threads before it */
+    auto &bucket_starts = use_buffer(ws, ws.counters[1], num_buckets + 1);
+    size_t offset = 0;
+    for (size_t b = 0; b < num_buckets; b++) {
+        bucket_starts[b] = offset;
+        for (size_t i = 0; i < num_threads; i++) {
+            const size_t count = offsets[i * num_buckets + b];
+            offsets[i * num_buckets + b] = offset;
+            offset += count;
+        }
+    }
+    bucket_starts[num_buckets] = n;
+
+    /* Scatter -- every thread has its own output positions, no synchronization needed */
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const size_t start = i * chunk_size;
+        const size_t end = (i == num_threads - 1) ? n : start + chunk_size;
+
+        size_t *positions = &offsets[i * num_buckets];
+        for (size_t j = start; j < end; j++)
+            scratch[positions[bucket_of(arr[j])]++] = arr[j];
+    });
+
+    /* Sort the buckets independently -- the array is free now, it is the buffer of the local sorts */
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto b) {
+        const size_t start = bucket_starts[b];
+        bucket_sort(scratch.data() + start, arr.data() + start, bucket_starts[b + 1] - start);
+    });
+
+    /* The sorted numbers are in the scratch buffer */
+    arr.swap(scratch);
+}
@@ -0,0 +1,21 @@
+#include "calculations/cpu/simd_sort.h"
+
+void simd_merge_sort_range(decimal *arr, decimal *buffer, const size_t n, const simd_kernels &kernels) {
+    kernels.sort_runs(arr, n);
+
+    /* Merge the runs bottom-up, each level from src to dst */
+    decimal *src = arr;
+    decimal *dst = buffer;
+    for (size_t size = kernels.lanes; size < n; size *= 2) {
+        for (size_t left = 0; left < n; left += 2 * size) {
+            const size_t mid = std::min(left + size, n);
+            const size_t right = std::min(left + 2 * size, n);
+            kernels.merge(src + left, mid - left, src + mid, right - mid, dst + left);
+        }
+        std::swap(src, dst);
+    }
+
+    /* Odd number of levels -- the sorted numbers are in the buffer */
+    if (src != arr)
+        std::copy(src, src + n, arr);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+#include <execution>
+
+#include "calculations/cpu/merge_sort.h"
+#include "simd/simd_kernels.h"
+#include "utils/utils.h"
+
+/*
+ * Vectorized merge sort (the kernels of the instruction set picked at runtime -- simd_kernels.h)
+ * 1) Blocks of lanes x lanes numbers (e.g., 4 x 4 doubles with AVX2, 8 x 8 with AVX-512) are loaded into registers and
+ *    sorted by a sorting network "vertically" (compare-exchange = one min / max pair for all the columns at once),
+ *    then the block is transposed, so each register holds one sorted run of lanes numbers
+ * 2) The runs are merged bottom-up; the merge works one register at a time -- the next register of the inputs is merged
+ *    with the largest register of the output so far by a bitonic merge network in the registers
+ */
+
+/**
+ * Sequential vectorized merge sort of a range (no allocations -- the merges alternate between the range and the buffer)
+ * @param arr Range to be sorted
+ * @param buffer Scratch buffer of at least n elements (must not overlap with the range)
+ * @param n Number of elements
+ * @param kernels Kernels of the instruction set
+ */
+void simd_merge_sort_range(decimal *arr, decimal *buffer, size_t n, const simd_kernels &kernels);
+
+/**
+ * Vectorized merge sort (ascending)
+ * Runs of lanes numbers are made by the sorting networks, then merged bottom-up with the vectorized merge
+ * (merge_level from the merge_sort.h file), the source and the destination of the merges alternate between the array
+ * and one scratch buffer
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param arr Array to be sorted (its buffer may be swapped with the scratch buffer)
+ * @param ws Workspace (scratch buffer, chunk indices)
+ * @param kernels Kernels of the instruction set
+ */
+template <typename exec_policy>
+void simd_merge_sort(exec_policy policy, decimal_vector &arr, workspace &ws, const simd_kernels &kernels) {
+    const size_t n = arr.size();
+    if (n < 2)
+        return;
+
+    /* Runs of lanes numbers -- in parallel, every thread takes whole blocks */
+    const size_t block_size = kernels.lanes * kernels.lanes;
+    const auto max_num_threads = std::thread::hardware_concurrency();
+    const size_t num_blocks = (n + block_size - 1) / block_size;
+    const size_t blocks_per_thread = (num_blocks + max_num_threads - 1) / max_num_threads;
+    auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+    std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const size_t start = std::min(i * blocks_per_thread * block_size, n);
+        const size_t end = std::min(start + blocks_per_thread * block_size, n);
+        kernels.sort_runs(arr.data() + start, end - start);
+    });
+
+    /* Merge the runs bottom-up, each level from src to dst (split across the threads by the merge path) */
+    auto &scratch = use_buffer(ws, ws.scratch, n);
+    decimal *src = arr.data();
+    decimal *dst = scratch.data();
+    for (size_t size = kernels.lanes; size < n; size *= 2) {
+        merge_level(policy, chunk_indices, src, dst, n, size, kernels.merge);
+        std::swap(src, dst);
+    }
+
+    /* Odd number of levels -- the sorted numbers are in the scratch buffer */
+    if (src != arr.data())
+        arr.swap(scratch);
+}
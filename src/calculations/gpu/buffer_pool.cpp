@@ -0,0 +1,37 @@
+#include "calculations/gpu/buffer_pool.h"
+
+pooled_buffer device_buffer_pool::acquire(size_t bytes) {
+    /* Size class -- the next power of two */
+    size_t size_class = 0;
+    while ((pool_min_class_size << size_class) < bytes)
+        size_class++;
+    if (this->free_buffers.size() <= size_class)
+        this->free_buffers.resize(size_class + 1);
+
+    pooled_buffer pooled;
+    pooled.size = pool_min_class_size << size_class;
+
+    /* Free buffer of the class, or a new one */
+    auto &free_list = this->free_buffers[size_class];
+    if (!free_list.empty()) {
+        pooled.buffer = free_list.back();
+        free_list.pop_back();
+    } else {
+        pooled.buffer = cl::Buffer(this->context, CL_MEM_READ_WRITE, pooled.size);
+        this->allocations++;
+    }
+
+    return pooled;
+}
+
+void device_buffer_pool::release(pooled_buffer &buffer) {
+    if (!buffer.size)
+        return;
+
+    size_t size_class = 0;
+    while ((pool_min_class_size << size_class) < buffer.size)
+        size_class++;
+    this->free_buffers[size_class].push_back(buffer.buffer);
+
+    buffer = {};
+}
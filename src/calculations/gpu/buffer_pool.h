@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include <CL/cl.hpp>
+
+/*
+ * Pool of device buffers
+ * Allocating an OpenCL buffer is expensive (and so is the implicit copy of CL_MEM_COPY_HOST_PTR), so the buffers are
+ * never freed -- a released buffer goes to the free list of its size class (power of two bytes) and the next request of
+ * the same class takes it back, so after the first series of the biggest size, no buffers are allocated at all
+ */
+
+/** Smallest size class of the pool (bytes) -- smaller requests share it */
+constexpr size_t pool_min_class_size = 4096;
+
+/**
+ * Buffer of the pool with the size of its class
+ */
+struct pooled_buffer {
+    /** OpenCL buffer (at least size bytes) */
+    cl::Buffer buffer;
+    /** Size of the class of the buffer in bytes (0 = no buffer) */
+    size_t size = 0;
+};
+
+/**
+ * Counters of the device memory traffic (transfers between the host and the device, allocations)
+ */
+struct transfer_stats {
+    /** Bytes copied from the host to the device */
+    size_t bytes_uploaded = 0;
+    /** Bytes copied from the device to the host */
+    size_t bytes_downloaded = 0;
+    /** Number of buffers allocated on the device */
+    size_t allocations = 0;
+};
+
+/**
+ * Size-classed pool of device buffers (read-write)
+ */
+class device_buffer_pool {
+private:
+    /** Context of the buffers */
+    cl::Context context;
+    /** Free buffers of each size class (index = log2 of the size) */
+    std::vector<std::vector<cl::Buffer>> free_buffers;
+    /** Number of buffers allocated so far */
+    size_t allocations = 0;
+
+public:
+    /**
+     * Set the context of the buffers (before the first acquire)
+     * @param new_context Context
+     */
+    void set_context(const cl::Context &new_context) {
+        this->context = new_context;
+    }
+
+    /**
+     * Take a buffer of at least the given size -- a free buffer of its size class, or a new one
+     * @param bytes Size in bytes
+     * @return Buffer (release it when it is not needed anymore)
+     */
+    pooled_buffer acquire(size_t bytes);
+
+    /**
+     * Return a buffer to the pool (nothing happens for an empty one)
+     * @param buffer Buffer taken by acquire()
+     */
+    void release(pooled_buffer &buffer);
+
+    /**
+     * Number of buffers allocated so far (zero growth = the buffers were reused)
+     * @return Number of allocations
+     */
+    [[nodiscard]] size_t get_allocations() const {
+        return this->allocations;
+    }
+};
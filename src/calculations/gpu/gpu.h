@@ -52,6 +52,270 @@ __kernel void bitonic_sort(__global double *arr, const uint stage, const uint pa
     }
 }
 
+/**
+ * Compare-exchange of one pair of a block in local memory (one pass of the bitonic sort)
+ * @param block Block of the array in local memory
+ * @param lid Index of the pair in the block (local index)
+ * @param gid Index of the pair in the whole array (global index) -- gives the direction
+ * @param stage Current stage
+ * @param pair_distance Pair distance of the current pass
+ */
+void compare_exchange_local(__local double *block, const uint lid, const uint gid, const uint stage, const uint pair_distance) {
+    /* Calculate left and right indices (the same ones as in bitonic_sort, relative to the block) */
+    uint left_id = (lid & (pair_distance - 1)) + ((lid & ~(pair_distance - 1)) << 1);
+    uint right_id = left_id + pair_distance;
+
+    /* Load elements */
+    double left = block[left_id];
+    double right = block[right_id];
+
+    /* Determine the direction */
+    if ((gid >> stage) & 0x1) {
+        uint temp = right_id;
+        right_id = left_id;
+        left_id = temp;
+    }
+
+    /* Write back -- swap if necessary */
+    if (left < right) {
+        block[left_id] = left;
+        block[right_id] = right;
+    } else {
+        block[left_id] = right;
+        block[right_id] = left;
+    }
+}
+
+/**
+ * Bitonic sort of the blocks of 2 * local size elements in local memory -- all the stages that fit in a block, so
+ * the blocks are the sorted runs (in the directions of the whole sort) for the following global stages
+ * One work item per pair, one global read and write per element for all the stages
+ * @param arr Input array
+ * @param num_stages Number of stages of the whole sort
+ */
+__kernel void bitonic_sort_local(__global double *arr, const uint num_stages) {
+    /* Block of 2 * local size elements (local size 256 at most) */
+    __local double block[512];
+
+    uint lid = get_local_id(0);
+    uint gid = get_global_id(0);
+    uint size = get_local_size(0);
+    uint offset = get_group_id(0) * 2 * size;
+
+    /* Load the block */
+    block[lid] = arr[offset + lid];
+    block[lid + size] = arr[offset + lid + size];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* All the stages whose pair distances fit in the block */
+    for (uint stage = 0; stage < num_stages && (1u << stage) <= size; stage++)
+        for (uint pair_distance = 1u << stage; pair_distance > 0; pair_distance >>= 1) {
+            compare_exchange_local(block, lid, gid, stage, pair_distance);
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+    /* Write the block back */
+    arr[offset + lid] = block[lid];
+    arr[offset + lid + size] = block[lid + size];
+}
+
+/**
+ * The passes of a stage with the pair distance of the local size and smaller, in local memory (the passes with the
+ * bigger distances run by bitonic_sort before)
+ * @param arr Input array
+ * @param stage Current stage
+ */
+__kernel void bitonic_merge_local(__global double *arr, const uint stage) {
+    /* Block of 2 * local size elements (local size 256 at most) */
+    __local double block[512];
+
+    uint lid = get_local_id(0);
+    uint gid = get_global_id(0);
+    uint size = get_local_size(0);
+    uint offset = get_group_id(0) * 2 * size;
+
+    /* Load the block */
+    block[lid] = arr[offset + lid];
+    block[lid + size] = arr[offset + lid + size];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Passes from the pair distance of the local size down to 1 */
+    for (uint pair_distance = size; pair_distance > 0; pair_distance >>= 1) {
+        compare_exchange_local(block, lid, gid, stage, pair_distance);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /* Write the block back */
+    arr[offset + lid] = block[lid];
+    arr[offset + lid + size] = block[lid + size];
+}
+
+/**
+ * Map the numbers to order-preserving unsigned keys in place (radix sort) -- flip the sign bit of the positive numbers,
+ * all the bits of the negative ones
+ * @param keys Array (the numbers, as their bits)
+ * @param n Array size
+ */
+__kernel void radix_keys(__global ulong *keys, const uint n) {
+    uint i = get_global_id(0);
+    if (i < n) {
+        ulong bits = keys[i];
+        keys[i] = bits ^ ((bits >> 63) ? 0xFFFFFFFFFFFFFFFFUL : 0x8000000000000000UL);
+    }
+}
+
+/**
+ * Map the keys back to the numbers in place (inverse of radix_keys)
+ * @param keys Array of the keys
+ * @param n Array size
+ */
+__kernel void radix_values(__global ulong *keys, const uint n) {
+    uint i = get_global_id(0);
+    if (i < n) {
+        ulong bits = keys[i];
+        keys[i] = bits ^ ((bits >> 63) ? 0x8000000000000000UL : 0xFFFFFFFFFFFFFFFFUL);
+    }
+}
+
+/**
+ * Digit histogram of the tile of each work group (radix sort, 8-bit digits)
+ * The counts are stored digit by digit (counts[digit * groups + group]), so their exclusive scan gives the output offset
+ * of every digit of every tile
+ * @param keys Array of the keys
+ * @param counts Counts of the digits of the tiles (256 * number of groups)
+ * @param n Array size
+ * @param shift Position of the digit
+ * @param tile_size Number of keys of a tile
+ */
+__kernel void radix_histogram(__global const ulong *keys, __global uint *counts, const uint n, const uint shift, const uint tile_size) {
+    __local uint histogram[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint group = get_group_id(0);
+
+    /* Clear the histogram */
+    for (uint digit = lid; digit < 256; digit += size)
+        histogram[digit] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Count the digits of the tile */
+    uint start = group * tile_size;
+    uint end = min(start + tile_size, n);
+    for (uint i = start + lid; i < end; i += size)
+        atomic_inc(&histogram[(keys[i] >> shift) & 0xFF]);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Write the histogram */
+    for (uint digit = lid; digit < 256; digit += size)
+        counts[digit * get_num_groups(0) + group] = histogram[digit];
+}
+
+/**
+ * Exclusive prefix sum of the counts in place -- one work group walks all the counts by blocks of its size
+ * @param counts Counts (offsets afterwards)
+ * @param num_counts Number of counts
+ */
+__kernel void radix_scan(__global uint *counts, const uint num_counts) {
+    /* Local size 256 at most */
+    __local uint sums[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+
+    /* Sum of all the previous blocks */
+    uint total = 0;
+    for (uint start = 0; start < num_counts; start += size) {
+        uint i = start + lid;
+        uint value = i < num_counts ? counts[i] : 0;
+        sums[lid] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Inclusive scan of the block (Hillis-Steele) */
+        for (uint offset = 1; offset < size; offset <<= 1) {
+            uint add = lid >= offset ? sums[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            sums[lid] += add;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (i < num_counts)
+            counts[i] = total + sums[lid] - value;
+        total += sums[size - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+/**
+ * Stable scatter of the keys of the tile of each work group by their digit (radix sort)
+ * The tile is walked by chunks of the local size: the chunk is sorted by (digit, index) in local memory (bitonic), so
+ * the position of a key among the keys of its digit is its distance from the start of the run of the digit
+ * @param keys Array of the keys
+ * @param sorted Output -- keys ordered by the digit (stable)
+ * @param offsets Output offsets of the digits of the tiles (scanned counts of radix_histogram)
+ * @param n Array size
+ * @param shift Position of the digit
+ * @param tile_size Number of keys of a tile (multiple of the local size)
+ */
+__kernel void radix_scatter(__global const ulong *keys, __global ulong *sorted, __global const uint *offsets, const uint n, const uint shift, const uint tile_size) {
+    /* Local size 256 at most (a power of 2) */
+    __local ulong chunk[256];
+    __local uint order[256];
+    __local uint run_start[256];
+    __local uint next[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint group = get_group_id(0);
+
+    /* Output offset of each digit of the tile */
+    for (uint digit = lid; digit < 256; digit += size)
+        next[digit] = offsets[digit * get_num_groups(0) + group];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    uint start = group * tile_size;
+    uint end = min(start + tile_size, n);
+    for (uint base = start; base < end; base += size) {
+        /* Keys past the end get the digit 256 -- sorted last, never written */
+        uint i = base + lid;
+        uint digit = 256;
+        if (i < end) {
+            chunk[lid] = keys[i];
+            digit = (chunk[lid] >> shift) & 0xFF;
+        }
+        order[lid] = (digit << 8) | lid;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Bitonic sort of (digit, index) -- the indices make the entries unique, so the order is stable */
+        for (uint width = 2; width <= size; width <<= 1)
+            for (uint distance = width >> 1; distance > 0; distance >>= 1) {
+                uint partner = lid ^ distance;
+                uint mine = order[lid];
+                uint other = order[partner];
+                barrier(CLK_LOCAL_MEM_FENCE);
+                order[lid] = ((lid < partner) == ((lid & width) == 0)) ? min(mine, other) : max(mine, other);
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+        /* Start of the run of each digit */
+        uint entry = order[lid];
+        uint entry_digit = entry >> 8;
+        if (entry_digit < 256 && (lid == 0 || (order[lid - 1] >> 8) != entry_digit))
+            run_start[entry_digit] = lid;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Scatter -- after all the keys of the digit from the previous chunks */
+        if (entry_digit < 256)
+            sorted[next[entry_digit] + lid - run_start[entry_digit]] = chunk[entry & 0xFF];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* The last key of each run moves the offset of its digit */
+        if (entry_digit < 256 && (lid == size - 1 || (order[lid + 1] >> 8) != entry_digit))
+            next[entry_digit] += lid - run_start[entry_digit] + 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
 /**
  * Merge two sorted sub-arrays
  * UNUSED because it was slow (13.5 seconds) -- replaced by above bitonic_sort
@@ -111,33 +375,174 @@ __kernel void my_abs_diff(__global const double *arr, __global double *diff, con
 }
 
 /**
- * Compute sum of elements in the array and sum of squared elements in the array
+ * Order-preserving unsigned key of a number (radix select) -- the sign bit of the positive numbers flipped, all the bits
+ * of the negative ones
+ * @param value Number
+ * @return Key
+ */
+ulong select_key(double value) {
+    ulong bits = as_ulong(value);
+    return bits ^ ((bits >> 63) ? 0xFFFFFFFFFFFFFFFFUL : 0x8000000000000000UL);
+}
+
+/**
+ * Number of a key (inverse of select_key)
+ * @param key Key
+ * @return Number
+ */
+double select_value(ulong key) {
+    return as_double(key ^ ((key >> 63) ? 0x8000000000000000UL : 0xFFFFFFFFFFFFFFFFUL));
+}
+
+/**
+ * Start two radix selections (the lower and the upper middle element) -- clear the histograms, no digit known yet
+ * @param histograms Digit histograms of both selections (2 * 256)
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param ranks Ranks of the selected elements among the elements with the known digits
+ * @param lower Rank of the lower middle element
+ * @param upper Rank of the upper middle element
+ */
+__kernel void select_init(__global uint *histograms, __global ulong *prefixes, __global uint *ranks, const uint lower, const uint upper) {
+    uint i = get_global_id(0);
+    if (i < 512)
+        histograms[i] = 0;
+    if (i < 2) {
+        prefixes[i] = 0;
+        ranks[i] = i == 0 ? lower : upper;
+    }
+}
+
+/**
+ * Histogram of one digit of the keys that share the known digits with the selected elements (radix select, MSD first)
+ * Every work group counts its elements (grid-stride loop) in local memory, then adds its counts to the global ones
  * @param arr Array
- * @param sums Sum of elements
- * @param sums_sq Sum of squared elements
  * @param n Array size
+ * @param results Results of the selections (results[2] is the median of the array, see select_finish)
+ * @param deviations Select from the absolute deviations from the median instead of the array (no array of them is stored)
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param shift Position of the digit
+ * @param histograms Digit histograms of both selections
  */
-__kernel void reduce_sum(__global const double *arr, __global double *sums, __global double *sums_sq, const int n) {
-    /* Get index */
-    int gid = get_global_id(0);
-    /* Get local index */
-    int local_id = get_local_id(0);
-    /* Get group index */
-    int group_id = get_group_id(0);
+__kernel void select_histogram(__global const double *arr, const uint n, __global const double *results, const int deviations, __global const ulong *prefixes, const uint shift, __global uint *histograms) {
+    __local uint local_histograms[512];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+
+    /* Clear the histograms */
+    for (uint i = lid; i < 512; i += size)
+        local_histograms[i] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Only the elements with the same higher digits as the selected elements count (all of them for the first digit) */
+    uint high = shift + 8;
+    ulong lower_prefix = high < 64 ? prefixes[0] >> high : 0;
+    ulong upper_prefix = high < 64 ? prefixes[1] >> high : 0;
+    double median = results[2];
+
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        ulong key = select_key(deviations ? fabs(arr[i] - median) : arr[i]);
+        ulong key_prefix = high < 64 ? key >> high : 0;
+        uint digit = (key >> shift) & 0xFF;
+        if (key_prefix == lower_prefix)
+            atomic_inc(&local_histograms[digit]);
+        if (key_prefix == upper_prefix)
+            atomic_inc(&local_histograms[256 + digit]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Add the counts of the group to the global ones */
+    for (uint i = lid; i < 512; i += size)
+        if (local_histograms[i] > 0)
+            atomic_add(&histograms[i], local_histograms[i]);
+}
 
-    /* Local (shared) memory for partial sums */
-    __local double partial_sums[256];
-    __local double partial_sums_sq[256];
+/**
+ * Find the digit of each selected element in its histogram, then clear the histogram for the next digit (radix select)
+ * One work item per selection
+ * @param histograms Digit histograms of both selections
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param ranks Ranks of the selected elements among the elements with the known digits
+ * @param shift Position of the digit
+ */
+__kernel void select_digit(__global uint *histograms, __global ulong *prefixes, __global uint *ranks, const uint shift) {
+    uint s = get_global_id(0);
+    if (s >= 2)
+        return;
+
+    __global uint *histogram = histograms + 256 * s;
+    uint rank = ranks[s];
+    uint digit = 0;
+    while (rank >= histogram[digit]) {
+        rank -= histogram[digit];
+        digit++;
+    }
+
+    prefixes[s] |= (ulong) digit << shift;
+    ranks[s] = rank;
+    for (uint i = 0; i < 256; i++)
+        histogram[i] = 0;
+}
+
+/**
+ * Store the selected elements (all the digits known) -- results[0] and results[1] are the lower and the upper middle
+ * element, their mean (the median of the array) goes to results[2] after the selection from the array
+ * @param prefixes Keys of the selected elements
+ * @param results Results of the selections
+ * @param deviations The selection was from the absolute deviations (the median is kept)
+ */
+__kernel void select_finish(__global const ulong *prefixes, __global double *results, const int deviations) {
+    if (get_global_id(0) != 0)
+        return;
+
+    results[0] = select_value(prefixes[0]);
+    results[1] = select_value(prefixes[1]);
+    if (!deviations)
+        results[2] = (results[0] + results[1]) / 2;
+}
+
+/**
+ * Compute sum of elements in the array and sum of squared elements in the array (first pass)
+ * Every work item sums double4 vectors of the array with the stride of the whole grid (the last n % 4 elements one by
+ * one), then the work group reduces the sums of its work items in local memory -- one partial sum per work group
+ * @param arr Array
+ * @param n Array size
+ * @param sums Sum of elements of each work group
+ * @param sums_sq Sum of squared elements of each work group
+ * @param partial_sums Local memory for the sums of the work items (work group size, a power of 2)
+ * @param partial_sums_sq Local memory for the sums of squares of the work items
+ */
+__kernel void reduce_sum(__global const double *arr, const uint n, __global double *sums, __global double *sums_sq, __local double *partial_sums, __local double *partial_sums_sq) {
+    /* Get indices */
+    uint gid = get_global_id(0);
+    uint local_id = get_local_id(0);
+    uint global_size = get_global_size(0);
 
-    /* Each thread loads one element into local memory */
-    partial_sums[local_id] = (gid < n) ? arr[gid] : 0.0;
-    partial_sums_sq[local_id] = (gid < n) ? arr[gid] * arr[gid] : 0.0;
+    /* Whole vectors (one wide load each) */
+    double4 vector_sum = 0;
+    double4 vector_sum_sq = 0;
+    uint num_vectors = n / 4;
+    for (uint i = gid; i < num_vectors; i += global_size) {
+        double4 values = vload4(i, arr);
+        vector_sum += values;
+        vector_sum_sq += values * values;
+    }
+
+    /* Lanes of the vectors, then the rest of the elements */
+    double sum = vector_sum.s0 + vector_sum.s1 + vector_sum.s2 + vector_sum.s3;
+    double sum_sq = vector_sum_sq.s0 + vector_sum_sq.s1 + vector_sum_sq.s2 + vector_sum_sq.s3;
+    for (uint i = num_vectors * 4 + gid; i < n; i += global_size) {
+        sum += arr[i];
+        sum_sq += arr[i] * arr[i];
+    }
+    partial_sums[local_id] = sum;
+    partial_sums_sq[local_id] = sum_sq;
 
     /* Synchronize */
     barrier(CLK_LOCAL_MEM_FENCE);
 
     /* Reduction in shared memory -- within a group */
-    for (int stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
         if (local_id < stride) {
             partial_sums[local_id] += partial_sums[local_id + stride];
             partial_sums_sq[local_id] += partial_sums_sq[local_id + stride];
@@ -149,8 +554,51 @@ __kernel void reduce_sum(__global const double *arr, __global double *sums, __gl
 
     /* Write result for this block to global memory */
     if (local_id == 0) {
-        sums[group_id] = partial_sums[0];
-        sums_sq[group_id] = partial_sums_sq[0];
+        sums[get_group_id(0)] = partial_sums[0];
+        sums_sq[get_group_id(0)] = partial_sums_sq[0];
+    }
+}
+
+/**
+ * Sum the partial sums of the work groups of reduce_sum (second pass, a single work group)
+ * @param sums Sum of elements of each work group
+ * @param sums_sq Sum of squared elements of each work group
+ * @param num_sums Number of the partial sums
+ * @param results Sum of all the elements (results[0]) and of their squares (results[1])
+ * @param partial_sums Local memory for the sums of the work items (work group size, a power of 2)
+ * @param partial_sums_sq Local memory for the sums of squares of the work items
+ */
+__kernel void reduce_sum_final(__global const double *sums, __global const double *sums_sq, const uint num_sums, __global double *results, __local double *partial_sums, __local double *partial_sums_sq) {
+    uint local_id = get_local_id(0);
+
+    /* Each work item sums the partial sums with the stride of the group */
+    double sum = 0;
+    double sum_sq = 0;
+    for (uint i = local_id; i < num_sums; i += get_local_size(0)) {
+        sum += sums[i];
+        sum_sq += sums_sq[i];
+    }
+    partial_sums[local_id] = sum;
+    partial_sums_sq[local_id] = sum_sq;
+
+    /* Synchronize */
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Reduction in shared memory */
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+        if (local_id < stride) {
+            partial_sums[local_id] += partial_sums[local_id + stride];
+            partial_sums_sq[local_id] += partial_sums_sq[local_id + stride];
+        }
+
+        /* Wait for all threads to finish */
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /* The only numbers read back by the host */
+    if (local_id == 0) {
+        results[0] = partial_sums[0];
+        results[1] = partial_sums_sq[0];
     }
 }
 )";
@@ -200,6 +648,270 @@ __kernel void bitonic_sort(__global float *arr, const uint stage, const uint pas
     }
 }
 
+/**
+ * Compare-exchange of one pair of a block in local memory (one pass of the bitonic sort)
+ * @param block Block of the array in local memory
+ * @param lid Index of the pair in the block (local index)
+ * @param gid Index of the pair in the whole array (global index) -- gives the direction
+ * @param stage Current stage
+ * @param pair_distance Pair distance of the current pass
+ */
+void compare_exchange_local(__local float *block, const uint lid, const uint gid, const uint stage, const uint pair_distance) {
+    /* Calculate left and right indices (the same ones as in bitonic_sort, relative to the block) */
+    uint left_id = (lid & (pair_distance - 1)) + ((lid & ~(pair_distance - 1)) << 1);
+    uint right_id = left_id + pair_distance;
+
+    /* Load elements */
+    float left = block[left_id];
+    float right = block[right_id];
+
+    /* Determine the direction */
+    if ((gid >> stage) & 0x1) {
+        uint temp = right_id;
+        right_id = left_id;
+        left_id = temp;
+    }
+
+    /* Write back -- swap if necessary */
+    if (left < right) {
+        block[left_id] = left;
+        block[right_id] = right;
+    } else {
+        block[left_id] = right;
+        block[right_id] = left;
+    }
+}
+
+/**
+ * Bitonic sort of the blocks of 2 * local size elements in local memory -- all the stages that fit in a block, so
+ * the blocks are the sorted runs (in the directions of the whole sort) for the following global stages
+ * One work item per pair, one global read and write per element for all the stages
+ * @param arr Input array
+ * @param num_stages Number of stages of the whole sort
+ */
+__kernel void bitonic_sort_local(__global float *arr, const uint num_stages) {
+    /* Block of 2 * local size elements (local size 256 at most) */
+    __local float block[512];
+
+    uint lid = get_local_id(0);
+    uint gid = get_global_id(0);
+    uint size = get_local_size(0);
+    uint offset = get_group_id(0) * 2 * size;
+
+    /* Load the block */
+    block[lid] = arr[offset + lid];
+    block[lid + size] = arr[offset + lid + size];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* All the stages whose pair distances fit in the block */
+    for (uint stage = 0; stage < num_stages && (1u << stage) <= size; stage++)
+        for (uint pair_distance = 1u << stage; pair_distance > 0; pair_distance >>= 1) {
+            compare_exchange_local(block, lid, gid, stage, pair_distance);
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+    /* Write the block back */
+    arr[offset + lid] = block[lid];
+    arr[offset + lid + size] = block[lid + size];
+}
+
+/**
+ * The passes of a stage with the pair distance of the local size and smaller, in local memory (the passes with the
+ * bigger distances run by bitonic_sort before)
+ * @param arr Input array
+ * @param stage Current stage
+ */
+__kernel void bitonic_merge_local(__global float *arr, const uint stage) {
+    /* Block of 2 * local size elements (local size 256 at most) */
+    __local float block[512];
+
+    uint lid = get_local_id(0);
+    uint gid = get_global_id(0);
+    uint size = get_local_size(0);
+    uint offset = get_group_id(0) * 2 * size;
+
+    /* Load the block */
+    block[lid] = arr[offset + lid];
+    block[lid + size] = arr[offset + lid + size];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Passes from the pair distance of the local size down to 1 */
+    for (uint pair_distance = size; pair_distance > 0; pair_distance >>= 1) {
+        compare_exchange_local(block, lid, gid, stage, pair_distance);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /* Write the block back */
+    arr[offset + lid] = block[lid];
+    arr[offset + lid + size] = block[lid + size];
+}
+
+/**
+ * Map the numbers to order-preserving unsigned keys in place (radix sort) -- flip the sign bit of the positive numbers,
+ * all the bits of the negative ones
+ * @param keys Array (the numbers, as their bits)
+ * @param n Array size
+ */
+__kernel void radix_keys(__global uint *keys, const uint n) {
+    uint i = get_global_id(0);
+    if (i < n) {
+        uint bits = keys[i];
+        keys[i] = bits ^ ((bits >> 31) ? 0xFFFFFFFFU : 0x80000000U);
+    }
+}
+
+/**
+ * Map the keys back to the numbers in place (inverse of radix_keys)
+ * @param keys Array of the keys
+ * @param n Array size
+ */
+__kernel void radix_values(__global uint *keys, const uint n) {
+    uint i = get_global_id(0);
+    if (i < n) {
+        uint bits = keys[i];
+        keys[i] = bits ^ ((bits >> 31) ? 0x80000000U : 0xFFFFFFFFU);
+    }
+}
+
+/**
+ * Digit histogram of the tile of each work group (radix sort, 8-bit digits)
+ * The counts are stored digit by digit (counts[digit * groups + group]), so their exclusive scan gives the output offset
+ * of every digit of every tile
+ * @param keys Array of the keys
+ * @param counts Counts of the digits of the tiles (256 * number of groups)
+ * @param n Array size
+ * @param shift Position of the digit
+ * @param tile_size Number of keys of a tile
+ */
+__kernel void radix_histogram(__global const uint *keys, __global uint *counts, const uint n, const uint shift, const uint tile_size) {
+    __local uint histogram[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint group = get_group_id(0);
+
+    /* Clear the histogram */
+    for (uint digit = lid; digit < 256; digit += size)
+        histogram[digit] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Count the digits of the tile */
+    uint start = group * tile_size;
+    uint end = min(start + tile_size, n);
+    for (uint i = start + lid; i < end; i += size)
+        atomic_inc(&histogram[(keys[i] >> shift) & 0xFF]);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Write the histogram */
+    for (uint digit = lid; digit < 256; digit += size)
+        counts[digit * get_num_groups(0) + group] = histogram[digit];
+}
+
+/**
+ * Exclusive prefix sum of the counts in place -- one work group walks all the counts by blocks of its size
+ * @param counts Counts (offsets afterwards)
+ * @param num_counts Number of counts
+ */
+__kernel void radix_scan(__global uint *counts, const uint num_counts) {
+    /* Local size 256 at most */
+    __local uint sums[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+
+    /* Sum of all the previous blocks */
+    uint total = 0;
+    for (uint start = 0; start < num_counts; start += size) {
+        uint i = start + lid;
+        uint value = i < num_counts ? counts[i] : 0;
+        sums[lid] = value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Inclusive scan of the block (Hillis-Steele) */
+        for (uint offset = 1; offset < size; offset <<= 1) {
+            uint add = lid >= offset ? sums[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            sums[lid] += add;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        if (i < num_counts)
+            counts[i] = total + sums[lid] - value;
+        total += sums[size - 1];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+/**
+ * Stable scatter of the keys of the tile of each work group by their digit (radix sort)
+ * The tile is walked by chunks of the local size: the chunk is sorted by (digit, index) in local memory (bitonic), so
+ * the position of a key among the keys of its digit is its distance from the start of the run of the digit
+ * @param keys Array of the keys
+ * @param sorted Output -- keys ordered by the digit (stable)
+ * @param offsets Output offsets of the digits of the tiles (scanned counts of radix_histogram)
+ * @param n Array size
+ * @param shift Position of the digit
+ * @param tile_size Number of keys of a tile (multiple of the local size)
+ */
+__kernel void radix_scatter(__global const uint *keys, __global uint *sorted, __global const uint *offsets, const uint n, const uint shift, const uint tile_size) {
+    /* Local size 256 at most (a power of 2) */
+    __local uint chunk[256];
+    __local uint order[256];
+    __local uint run_start[256];
+    __local uint next[256];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint group = get_group_id(0);
+
+    /* Output offset of each digit of the tile */
+    for (uint digit = lid; digit < 256; digit += size)
+        next[digit] = offsets[digit * get_num_groups(0) + group];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    uint start = group * tile_size;
+    uint end = min(start + tile_size, n);
+    for (uint base = start; base < end; base += size) {
+        /* Keys past the end get the digit 256 -- sorted last, never written */
+        uint i = base + lid;
+        uint digit = 256;
+        if (i < end) {
+            chunk[lid] = keys[i];
+            digit = (chunk[lid] >> shift) & 0xFF;
+        }
+        order[lid] = (digit << 8) | lid;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Bitonic sort of (digit, index) -- the indices make the entries unique, so the order is stable */
+        for (uint width = 2; width <= size; width <<= 1)
+            for (uint distance = width >> 1; distance > 0; distance >>= 1) {
+                uint partner = lid ^ distance;
+                uint mine = order[lid];
+                uint other = order[partner];
+                barrier(CLK_LOCAL_MEM_FENCE);
+                order[lid] = ((lid < partner) == ((lid & width) == 0)) ? min(mine, other) : max(mine, other);
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+        /* Start of the run of each digit */
+        uint entry = order[lid];
+        uint entry_digit = entry >> 8;
+        if (entry_digit < 256 && (lid == 0 || (order[lid - 1] >> 8) != entry_digit))
+            run_start[entry_digit] = lid;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* Scatter -- after all the keys of the digit from the previous chunks */
+        if (entry_digit < 256)
+            sorted[next[entry_digit] + lid - run_start[entry_digit]] = chunk[entry & 0xFF];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        /* The last key of each run moves the offset of its digit */
+        if (entry_digit < 256 && (lid == size - 1 || (order[lid + 1] >> 8) != entry_digit))
+            next[entry_digit] += lid - run_start[entry_digit] + 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
 /**
  * Merge two sorted sub-arrays
  * UNUSED because it was slow (13.5 seconds) -- replaced by above bitonic_sort
@@ -259,33 +971,174 @@ __kernel void my_abs_diff(__global const float *arr, __global float *diff, const
 }
 
 /**
- * Compute sum of elements in the array and sum of squared elements in the array
+ * Order-preserving unsigned key of a number (radix select) -- the sign bit of the positive numbers flipped, all the bits
+ * of the negative ones
+ * @param value Number
+ * @return Key
+ */
+uint select_key(float value) {
+    uint bits = as_uint(value);
+    return bits ^ ((bits >> 31) ? 0xFFFFFFFFU : 0x80000000U);
+}
+
+/**
+ * Number of a key (inverse of select_key)
+ * @param key Key
+ * @return Number
+ */
+float select_value(uint key) {
+    return as_float(key ^ ((key >> 31) ? 0x80000000U : 0xFFFFFFFFU));
+}
+
+/**
+ * Start two radix selections (the lower and the upper middle element) -- clear the histograms, no digit known yet
+ * @param histograms Digit histograms of both selections (2 * 256)
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param ranks Ranks of the selected elements among the elements with the known digits
+ * @param lower Rank of the lower middle element
+ * @param upper Rank of the upper middle element
+ */
+__kernel void select_init(__global uint *histograms, __global uint *prefixes, __global uint *ranks, const uint lower, const uint upper) {
+    uint i = get_global_id(0);
+    if (i < 512)
+        histograms[i] = 0;
+    if (i < 2) {
+        prefixes[i] = 0;
+        ranks[i] = i == 0 ? lower : upper;
+    }
+}
+
+/**
+ * Histogram of one digit of the keys that share the known digits with the selected elements (radix select, MSD first)
+ * Every work group counts its elements (grid-stride loop) in local memory, then adds its counts to the global ones
  * @param arr Array
- * @param sums Sum of elements
- * @param sums_sq Sum of squared elements
  * @param n Array size
+ * @param results Results of the selections (results[2] is the median of the array, see select_finish)
+ * @param deviations Select from the absolute deviations from the median instead of the array (no array of them is stored)
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param shift Position of the digit
+ * @param histograms Digit histograms of both selections
  */
-__kernel void reduce_sum(__global const float *arr, __global float *sums, __global float *sums_sq, const int n) {
-    /* Get index */
-    int gid = get_global_id(0);
-    /* Get local index */
-    int local_id = get_local_id(0);
-    /* Get group index */
-    int group_id = get_group_id(0);
+__kernel void select_histogram(__global const float *arr, const uint n, __global const float *results, const int deviations, __global const uint *prefixes, const uint shift, __global uint *histograms) {
+    __local uint local_histograms[512];
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+
+    /* Clear the histograms */
+    for (uint i = lid; i < 512; i += size)
+        local_histograms[i] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Only the elements with the same higher digits as the selected elements count (all of them for the first digit) */
+    uint high = shift + 8;
+    uint lower_prefix = high < 32 ? prefixes[0] >> high : 0;
+    uint upper_prefix = high < 32 ? prefixes[1] >> high : 0;
+    float median = results[2];
+
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        uint key = select_key(deviations ? fabs(arr[i] - median) : arr[i]);
+        uint key_prefix = high < 32 ? key >> high : 0;
+        uint digit = (key >> shift) & 0xFF;
+        if (key_prefix == lower_prefix)
+            atomic_inc(&local_histograms[digit]);
+        if (key_prefix == upper_prefix)
+            atomic_inc(&local_histograms[256 + digit]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Add the counts of the group to the global ones */
+    for (uint i = lid; i < 512; i += size)
+        if (local_histograms[i] > 0)
+            atomic_add(&histograms[i], local_histograms[i]);
+}
 
-    /* Local (shared) memory for partial sums */
-    __local float partial_sums[256];
-    __local float partial_sums_sq[256];
+/**
+ * Find the digit of each selected element in its histogram, then clear the histogram for the next digit (radix select)
+ * One work item per selection
+ * @param histograms Digit histograms of both selections
+ * @param prefixes Keys of the selected elements (the known digits)
+ * @param ranks Ranks of the selected elements among the elements with the known digits
+ * @param shift Position of the digit
+ */
+__kernel void select_digit(__global uint *histograms, __global uint *prefixes, __global uint *ranks, const uint shift) {
+    uint s = get_global_id(0);
+    if (s >= 2)
+        return;
+
+    __global uint *histogram = histograms + 256 * s;
+    uint rank = ranks[s];
+    uint digit = 0;
+    while (rank >= histogram[digit]) {
+        rank -= histogram[digit];
+        digit++;
+    }
+
+    prefixes[s] |= (uint) digit << shift;
+    ranks[s] = rank;
+    for (uint i = 0; i < 256; i++)
+        histogram[i] = 0;
+}
+
+/**
+ * Store the selected elements (all the digits known) -- results[0] and results[1] are the lower and the upper middle
+ * element, their mean (the median of the array) goes to results[2] after the selection from the array
+ * @param prefixes Keys of the selected elements
+ * @param results Results of the selections
+ * @param deviations The selection was from the absolute deviations (the median is kept)
+ */
+__kernel void select_finish(__global const uint *prefixes, __global float *results, const int deviations) {
+    if (get_global_id(0) != 0)
+        return;
+
+    results[0] = select_value(prefixes[0]);
+    results[1] = select_value(prefixes[1]);
+    if (!deviations)
+        results[2] = (results[0] + results[1]) / 2;
+}
+
+/**
+ * Compute sum of elements in the array and sum of squared elements in the array (first pass)
+ * Every work item sums float8 vectors of the array with the stride of the whole grid (the last n % 8 elements one by
+ * one), then the work group reduces the sums of its work items in local memory -- one partial sum per work group
+ * @param arr Array
+ * @param n Array size
+ * @param sums Sum of elements of each work group
+ * @param sums_sq Sum of squared elements of each work group
+ * @param partial_sums Local memory for the sums of the work items (work group size, a power of 2)
+ * @param partial_sums_sq Local memory for the sums of squares of the work items
+ */
+__kernel void reduce_sum(__global const float *arr, const uint n, __global float *sums, __global float *sums_sq, __local float *partial_sums, __local float *partial_sums_sq) {
+    /* Get indices */
+    uint gid = get_global_id(0);
+    uint local_id = get_local_id(0);
+    uint global_size = get_global_size(0);
 
-    /* Each thread loads one element into local memory */
-    partial_sums[local_id] = (gid < n) ? arr[gid] : 0.0;
-    partial_sums_sq[local_id] = (gid < n) ? arr[gid] * arr[gid] : 0.0;
+    /* Whole vectors (one wide load each) */
+    float8 vector_sum = 0;
+    float8 vector_sum_sq = 0;
+    uint num_vectors = n / 8;
+    for (uint i = gid; i < num_vectors; i += global_size) {
+        float8 values = vload8(i, arr);
+        vector_sum += values;
+        vector_sum_sq += values * values;
+    }
+
+    /* Lanes of the vectors, then the rest of the elements */
+    float sum = vector_sum.s0 + vector_sum.s1 + vector_sum.s2 + vector_sum.s3 + vector_sum.s4 + vector_sum.s5 + vector_sum.s6 + vector_sum.s7;
+    float sum_sq = vector_sum_sq.s0 + vector_sum_sq.s1 + vector_sum_sq.s2 + vector_sum_sq.s3 + vector_sum_sq.s4 + vector_sum_sq.s5 + vector_sum_sq.s6 + vector_sum_sq.s7;
+    for (uint i = num_vectors * 8 + gid; i < n; i += global_size) {
+        sum += arr[i];
+        sum_sq += arr[i] * arr[i];
+    }
+    partial_sums[local_id] = sum;
+    partial_sums_sq[local_id] = sum_sq;
 
     /* Synchronize */
     barrier(CLK_LOCAL_MEM_FENCE);
 
     /* Reduction in shared memory -- within a group */
-    for (int stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
         if (local_id < stride) {
             partial_sums[local_id] += partial_sums[local_id + stride];
             partial_sums_sq[local_id] += partial_sums_sq[local_id + stride];
@@ -297,8 +1150,51 @@ __kernel void reduce_sum(__global const float *arr, __global float *sums, __glob
 
     /* Write result for this block to global memory */
     if (local_id == 0) {
-        sums[group_id] = partial_sums[0];
-        sums_sq[group_id] = partial_sums_sq[0];
+        sums[get_group_id(0)] = partial_sums[0];
+        sums_sq[get_group_id(0)] = partial_sums_sq[0];
+    }
+}
+
+/**
+ * Sum the partial sums of the work groups of reduce_sum (second pass, a single work group)
+ * @param sums Sum of elements of each work group
+ * @param sums_sq Sum of squared elements of each work group
+ * @param num_sums Number of the partial sums
+ * @param results Sum of all the elements (results[0]) and of their squares (results[1])
+ * @param partial_sums Local memory for the sums of the work items (work group size, a power of 2)
+ * @param partial_sums_sq Local memory for the sums of squares of the work items
+ */
+__kernel void reduce_sum_final(__global const float *sums, __global const float *sums_sq, const uint num_sums, __global float *results, __local float *partial_sums, __local float *partial_sums_sq) {
+    uint local_id = get_local_id(0);
+
+    /* Each work item sums the partial sums with the stride of the group */
+    float sum = 0;
+    float sum_sq = 0;
+    for (uint i = local_id; i < num_sums; i += get_local_size(0)) {
+        sum += sums[i];
+        sum_sq += sums_sq[i];
+    }
+    partial_sums[local_id] = sum;
+    partial_sums_sq[local_id] = sum_sq;
+
+    /* Synchronize */
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    /* Reduction in shared memory */
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+        if (local_id < stride) {
+            partial_sums[local_id] += partial_sums[local_id + stride];
+            partial_sums_sq[local_id] += partial_sums_sq[local_id + stride];
+        }
+
+        /* Wait for all threads to finish */
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    /* The only numbers read back by the host */
+    if (local_id == 0) {
+        results[0] = partial_sums[0];
+        results[1] = partial_sums_sq[0];
     }
 }
 )";
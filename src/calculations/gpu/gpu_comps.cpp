@@ -7,6 +7,24 @@ gpu_comps::gpu_comps() {
     this->context = cl::Context(device);
     this->queue = cl::CommandQueue(context, device);
     this->program = load_program(context, device, kernel_source);
+    this->pool.set_context(this->context);
+
+    /*
+     * Work group size of the sum reduction -- the largest power of 2 allowed by the device and by both kernels (they run
+     * with the same local size), with room for the local arrays of the work items next to the local memory the kernels
+     * use by themselves
+     */
+    const cl::Kernel reduce_kernels[] = {cl::Kernel(this->program, "reduce_sum"), cl::Kernel(this->program, "reduce_sum_final")};
+    size_t max_group_size = this->device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    const size_t device_local_memory = this->device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+    size_t local_memory = device_local_memory;
+    for (const auto &kernel : reduce_kernels) {
+        max_group_size = std::min(max_group_size, kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(this->device));
+        const size_t kernel_local_memory = kernel.getWorkGroupInfo<CL_KERNEL_LOCAL_MEM_SIZE>(this->device);
+        local_memory = std::min(local_memory, device_local_memory > kernel_local_memory ? device_local_memory - kernel_local_memory : 0);
+    }
+    while (this->reduce_group_size * 2 <= max_group_size && 2 * sizeof(decimal) * this->reduce_group_size * 2 <= local_memory)
+        this->reduce_group_size *= 2;
 
     std::cout << this->get_gpu_info() << std::endl;
 }
@@ -15,5 +33,167 @@ std::string gpu_comps::get_gpu_info() {
     std::string info = "GPU Info:\n";
     info += "Platform: " + platform.getInfo<CL_PLATFORM_NAME>() + "\n";
     info += "Device: " + device.getInfo<CL_DEVICE_NAME>() + "\n";
+    info += "Reduction work group size: " + std::to_string(this->reduce_group_size) + "\n";
     return info;
-}
\ No newline at end of file
+}
+
+void gpu_comps::upload(const decimal_vector &arr, size_t padded_size) {
+    /* Uploaded by the sums function already */
+    if (this->resident_data == arr.data() && this->resident_size == arr.size())
+        return;
+
+    /* Input buffer big enough for the padded array (the old one goes back to the pool) */
+    if (this->input_buffer.size < sizeof(decimal) * padded_size) {
+        this->pool.release(this->input_buffer);
+        this->input_buffer = this->pool.acquire(sizeof(decimal) * padded_size);
+    }
+
+    /* Blocking -- the array may change right after the call */
+    if (arr.empty())
+        return;
+    this->queue.enqueueWriteBuffer(this->input_buffer.buffer, CL_TRUE, 0, sizeof(decimal) * arr.size(), arr.data());
+    this->stats.bytes_uploaded += sizeof(decimal) * arr.size();
+}
+
+void gpu_comps::radix_sort(decimal_vector &arr) {
+    const auto n = arr.size();
+
+    /* Input buffer -- uploaded by the sums function already (or now) */
+    this->upload(arr, n);
+    if (n < 2) {
+        this->release_input();
+        return;
+    }
+
+    /* Tiles of the work groups -- whole chunks of local_size keys, at most gpu_radix_max_groups of them */
+    const size_t num_chunks = (n + local_size - 1) / local_size;
+    const size_t chunks_per_group = (num_chunks + gpu_radix_max_groups - 1) / gpu_radix_max_groups;
+    const size_t tile_size = chunks_per_group * local_size;
+    const size_t num_groups = (n + tile_size - 1) / tile_size;
+    const size_t num_counts = gpu_radix_buckets * num_groups;
+
+    /* Second buffer of the keys and the counts of the digits of the tiles, from the pool */
+    auto buffer_sorted = this->pool.acquire(sizeof(decimal) * n);
+    auto buffer_counts = this->pool.acquire(sizeof(cl_uint) * num_counts);
+
+    /* Prepare kernels */
+    cl::Kernel keys_kernel(program, "radix_keys");
+    cl::Kernel values_kernel(program, "radix_values");
+    cl::Kernel histogram_kernel(program, "radix_histogram");
+    cl::Kernel scan_kernel(program, "radix_scan");
+    cl::Kernel scatter_kernel(program, "radix_scatter");
+
+    /* Numbers -> keys (in place) */
+    const size_t global_size = num_chunks * local_size;
+    keys_kernel.setArg(0, this->input_buffer.buffer);
+    keys_kernel.setArg(1, static_cast<cl_uint>(n));
+    this->queue.enqueueNDRangeKernel(keys_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
+
+    /* One pass per byte of the keys -- the in-order queue runs them one after another (no finish() per pass) */
+    cl::Buffer *source = &this->input_buffer.buffer;
+    cl::Buffer *destination = &buffer_sorted.buffer;
+    for (size_t shift = 0; shift < 8 * sizeof(decimal); shift += 8) {
+        histogram_kernel.setArg(0, *source);
+        histogram_kernel.setArg(1, buffer_counts.buffer);
+        histogram_kernel.setArg(2, static_cast<cl_uint>(n));
+        histogram_kernel.setArg(3, static_cast<cl_uint>(shift));
+        histogram_kernel.setArg(4, static_cast<cl_uint>(tile_size));
+        this->queue.enqueueNDRangeKernel(histogram_kernel, cl::NullRange, cl::NDRange(num_groups * local_size), cl::NDRange(local_size));
+
+        scan_kernel.setArg(0, buffer_counts.buffer);
+        scan_kernel.setArg(1, static_cast<cl_uint>(num_counts));
+        this->queue.enqueueNDRangeKernel(scan_kernel, cl::NullRange, cl::NDRange(local_size), cl::NDRange(local_size));
+
+        scatter_kernel.setArg(0, *source);
+        scatter_kernel.setArg(1, *destination);
+        scatter_kernel.setArg(2, buffer_counts.buffer);
+        scatter_kernel.setArg(3, static_cast<cl_uint>(n));
+        scatter_kernel.setArg(4, static_cast<cl_uint>(shift));
+        scatter_kernel.setArg(5, static_cast<cl_uint>(tile_size));
+        this->queue.enqueueNDRangeKernel(scatter_kernel, cl::NullRange, cl::NDRange(num_groups * local_size), cl::NDRange(local_size));
+
+        std::swap(source, destination);
+    }
+
+    /* Keys -> numbers (the even number of passes left them in the input buffer) */
+    values_kernel.setArg(0, this->input_buffer.buffer);
+    values_kernel.setArg(1, static_cast<cl_uint>(n));
+    this->queue.enqueueNDRangeKernel(values_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
+
+    /* Read result */
+    this->queue.enqueueReadBuffer(this->input_buffer.buffer, CL_TRUE, 0, sizeof(decimal) * n, arr.data());
+    this->stats.bytes_downloaded += sizeof(decimal) * n;
+
+    this->pool.release(buffer_sorted);
+    this->pool.release(buffer_counts);
+    this->release_input();
+}
+
+decimal gpu_comps::device_mad(const decimal_vector &arr) {
+    const auto n = arr.size();
+
+    /* Input buffer -- uploaded by the sums function already (or now) */
+    this->upload(arr, n);
+
+    /* Histograms and the state of the selections on the device, from the pool */
+    auto buffer_histograms = this->pool.acquire(sizeof(cl_uint) * 2 * gpu_radix_buckets);
+    auto buffer_prefixes = this->pool.acquire(sizeof(decimal) * 2);
+    auto buffer_ranks = this->pool.acquire(sizeof(cl_uint) * 2);
+    auto buffer_results = this->pool.acquire(sizeof(decimal) * 3);
+
+    /* Prepare kernels */
+    cl::Kernel init_kernel(program, "select_init");
+    cl::Kernel histogram_kernel(program, "select_histogram");
+    cl::Kernel digit_kernel(program, "select_digit");
+    cl::Kernel finish_kernel(program, "select_finish");
+    init_kernel.setArg(0, buffer_histograms.buffer);
+    init_kernel.setArg(1, buffer_prefixes.buffer);
+    init_kernel.setArg(2, buffer_ranks.buffer);
+    init_kernel.setArg(3, static_cast<cl_uint>((n - 1) / 2));
+    init_kernel.setArg(4, static_cast<cl_uint>(n / 2));
+    histogram_kernel.setArg(0, this->input_buffer.buffer);
+    histogram_kernel.setArg(1, static_cast<cl_uint>(n));
+    histogram_kernel.setArg(2, buffer_results.buffer);
+    histogram_kernel.setArg(4, buffer_prefixes.buffer);
+    histogram_kernel.setArg(6, buffer_histograms.buffer);
+    digit_kernel.setArg(0, buffer_histograms.buffer);
+    digit_kernel.setArg(1, buffer_prefixes.buffer);
+    digit_kernel.setArg(2, buffer_ranks.buffer);
+    finish_kernel.setArg(0, buffer_prefixes.buffer);
+    finish_kernel.setArg(1, buffer_results.buffer);
+
+    /* Work groups of the histograms -- each one walks the array with the stride of the whole grid */
+    const size_t num_groups = std::min(gpu_radix_max_groups, (n + local_size - 1) / local_size);
+
+    /* Middle elements of the array (their mean is the median), then of the absolute deviations from the median */
+    for (cl_int deviations = 0; deviations < 2; deviations++) {
+        this->queue.enqueueNDRangeKernel(init_kernel, cl::NullRange, cl::NDRange(2 * gpu_radix_buckets));
+
+        histogram_kernel.setArg(3, deviations);
+        for (size_t digit = 0; digit < sizeof(decimal); digit++) {
+            /* Most significant digit first */
+            const auto shift = static_cast<cl_uint>(8 * (sizeof(decimal) - 1 - digit));
+            histogram_kernel.setArg(5, shift);
+            this->queue.enqueueNDRangeKernel(histogram_kernel, cl::NullRange, cl::NDRange(num_groups * local_size), cl::NDRange(local_size));
+
+            digit_kernel.setArg(3, shift);
+            this->queue.enqueueNDRangeKernel(digit_kernel, cl::NullRange, cl::NDRange(2));
+        }
+
+        finish_kernel.setArg(2, deviations);
+        this->queue.enqueueNDRangeKernel(finish_kernel, cl::NullRange, cl::NDRange(1));
+    }
+
+    /* Read the middle absolute deviations only (the in-order queue ran all the kernels before) */
+    decimal middle[2] = {0, 0};
+    this->queue.enqueueReadBuffer(buffer_results.buffer, CL_TRUE, 0, sizeof(middle), middle);
+    this->stats.bytes_downloaded += sizeof(middle);
+
+    this->pool.release(buffer_histograms);
+    this->pool.release(buffer_prefixes);
+    this->pool.release(buffer_ranks);
+    this->pool.release(buffer_results);
+    this->release_input();
+
+    return static_cast<decimal>((n & 1) ? middle[1] : (middle[0] + middle[1]) / 2.0);
+}
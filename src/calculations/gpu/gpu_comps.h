@@ -7,6 +7,8 @@
 
 #include "calculations/computations.h"
 #include "calculations/gpu/gpu.h"
+#include "calculations/gpu/buffer_pool.h"
+#include "calculations/selection.h"
 #include "utils/utils.h"
 
 #include <execution>
@@ -20,8 +22,14 @@
 
 /* This, and the arg parser, are the only files where I found OOP to be useful */
 
-/** Local size for the sum reduce kernel */
+/** Local size of the sort and selection kernels (the size of their local arrays) */
 constexpr size_t local_size = 256;
+/** Number of decimals loaded at once by a work item of the sum reduce kernel (double4 / float8, 32 bytes) */
+constexpr size_t gpu_reduce_lanes = 32 / sizeof(decimal);
+/** Number of buckets of a pass of the GPU radix sort (8-bit digits) */
+constexpr size_t gpu_radix_buckets = 256;
+/** Most work groups of the GPU radix sort -- each one sorts a tile of the array, all the tiles' counts are scanned by one group */
+constexpr size_t gpu_radix_max_groups = 256;
 
 /**
  * GPU computation class
@@ -40,10 +48,58 @@ private:
     cl::CommandQueue queue;
     /** OpenCL Program */
     cl::Program program;
-    /** OpenCL Buffer for input data -- here for one-time CPU -> GPU transfer */
-    cl::Buffer input_buffer;
+    /** Pool of the device buffers (reused between the calls) */
+    device_buffer_pool pool;
+    /** Input data on the device, padded to the power of 2 for the sort -- one CPU -> GPU transfer per series */
+    pooled_buffer input_buffer;
+    /** Array uploaded to the input buffer by the sums function -- the MAD of the same series uses it, end_series() drops it */
+    const decimal *resident_data = nullptr;
+    /** Number of elements of the uploaded array */
+    size_t resident_size = 0;
+    /** Transfers between the host and the device so far */
+    transfer_stats stats;
+    /** Work group size of the sum reduce kernels -- the largest power of 2 the device and the kernel allow */
+    size_t reduce_group_size = 1;
+
+    /**
+     * Upload the array to the input buffer (padded to the power of 2), unless the sums function has just uploaded it
+     * @param arr Array
+     * @param padded_size Size of the input buffer in elements (at least the size of the array)
+     */
+    void upload(const decimal_vector &arr, size_t padded_size);
+
+    /**
+     * The uploaded array was used up (sorted, or its absolute differences computed) -- the next one is uploaded again
+     */
+    void release_input() {
+        this->resident_data = nullptr;
+        this->resident_size = 0;
+    }
+
+    /**
+     * LSD radix sort of the array on the GPU (--sort radix), 8 bits per pass
+     * The numbers are mapped to order-preserving unsigned keys in place, then every pass counts the digits of each tile
+     * (one tile per work group), scans the counts (one work group) and scatters the keys stably to the other buffer
+     * The number of passes is even, so the sorted keys end up in the input buffer, where they are mapped back
+     * @param arr Array
+     */
+    void radix_sort(decimal_vector &arr);
+
+    /**
+     * MAD of the array by two radix selections on the device (--mad select) -- only the two middle absolute deviations
+     * are read back
+     * Each selection finds the lower and the upper middle element together, one 8-bit digit per pass (MSD first): the
+     * elements that share the known digits are counted by the digit, the digit of the wanted rank is found from the
+     * counts; the second selection computes the absolute deviations from the median on the fly (no array of them)
+     * @param arr Array (not empty)
+     * @return Mean absolute deviation
+     */
+    decimal device_mad(const decimal_vector &arr);
 
 public:
+    /** The series are computed one by one (compute_series) -- one queue and one input buffer, order matters (CV -> MAD) */
+    static constexpr bool concurrent_series = false;
+
     /**
      * Constructor
      * Initializes OpenCL overhead
@@ -57,17 +113,46 @@ public:
     std::string get_gpu_info();
 
     /**
-     * Uses merge kernel to sort the array on the GPU
+     * End of the computations of a series (hides the one of the base class) -- the uploaded array is not used anymore,
+     * even if it was not sorted (--mad approx), so the next array is uploaded again, whatever its address is
+     */
+    void end_series() {
+        this->release_input();
+    }
+
+    /**
+     * Get the transfers between the host and the device and the buffer allocations so far
+     * @return Transfer counters
+     */
+    [[nodiscard]] transfer_stats get_transfer_stats() const {
+        transfer_stats current = this->stats;
+        current.allocations = this->pool.get_allocations();
+        return current;
+    }
+
+    /**
+     * Uses bitonic sort kernels (or the radix sort kernels, --sort radix) to sort the array on the GPU
+     * The array uploaded by the sums function is sorted in place (no second upload), the padding is filled on the device
+     * The passes with the pair distance up to the work group size run in local memory (many passes per kernel), only the
+     * passes with bigger distances run in global memory, one kernel each
      * This is not an optimal GPU sorting algorithm, but it works
      * This is an actual implementation of the "abstract" function in the base class
      * This function has to be implemented in here (.h), because of the template
      * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
      * @param policy Execution policy (unused for GPU computations, but needed for the interface)
      * @param arr Array
+     * @param ws Workspace of the computation
      */
     template<typename exec_policy>
-    void sort(exec_policy policy, std::vector<decimal> &arr) {
+    void sort(exec_policy policy, decimal_vector &arr, workspace &ws) {
         (void) policy;  /* Supress warning about unused policy */
+        (void) ws;  /* Supress warning about unused workspace (the padding is on the device) */
+
+        /* Radix sort (--sort radix) -- no padding needed */
+        if (this->options.sort == sort_algorithm::radix) {
+            this->radix_sort(arr);
+            return;
+        }
 
         const auto n = arr.size();
 
@@ -77,39 +162,62 @@ public:
             pow <<= 1;
             num_stages++;
         }
-        arr.resize(pow, std::numeric_limits<decimal>::max());
 
-        /* Create buffers -- input buffer is set by the sums function, but we need padded array here */
-        this->input_buffer = cl::Buffer(this->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(decimal) * pow, arr.data());
+        /* Input buffer -- uploaded by the sums function already (or now), padded by the maximums on the device */
+        this->upload(arr, pow);
+        if (pow > n)
+            this->queue.enqueueFillBuffer(this->input_buffer.buffer, std::numeric_limits<decimal>::max(), sizeof(decimal) * n, sizeof(decimal) * (pow - n));
 
-        /* Prepare kernel */
-        cl::Kernel bitonic_sort_kernel(program, "bitonic_sort");
-        bitonic_sort_kernel.setArg(0, this->input_buffer);
+        /* Nothing to sort (a single element) */
+        if (num_stages == 0) {
+            this->release_input();
+            return;
+        }
 
-        /* Global size */
-        size_t global_size = (pow / 2 + local_size - 1) / local_size * local_size;
+        /* Work groups of local_size pairs (fewer for small arrays) -- each one sorts a block of 2 * group_size elements */
+        const size_t group_size = std::min(local_size, pow / 2);
+        size_t group_stages = 0;
+        while ((static_cast<size_t>(1) << group_stages) < group_size)
+            group_stages++;
 
-        /* Iterate over stages */
-        for (size_t stage = 0; stage < num_stages; stage++) {
-            /* Set stage */
+        /* Prepare kernels */
+        cl::Kernel bitonic_sort_kernel(program, "bitonic_sort");
+        cl::Kernel bitonic_sort_local_kernel(program, "bitonic_sort_local");
+        cl::Kernel bitonic_merge_local_kernel(program, "bitonic_merge_local");
+        bitonic_sort_kernel.setArg(0, this->input_buffer.buffer);
+        bitonic_sort_local_kernel.setArg(0, this->input_buffer.buffer);
+        bitonic_merge_local_kernel.setArg(0, this->input_buffer.buffer);
+
+        /* Global size -- one work item per pair */
+        const size_t global_size = pow / 2;
+
+        /*
+         * The queue is in order, so the kernels run one after another without waiting on the host (no finish() per pass),
+         * the blocking read of the result waits for all of them
+         */
+
+        /* First stages -- all their passes within the blocks in local memory */
+        bitonic_sort_local_kernel.setArg(1, static_cast<int>(num_stages));
+        this->queue.enqueueNDRangeKernel(bitonic_sort_local_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(group_size));
+
+        /* Iterate over the remaining stages */
+        for (size_t stage = group_stages + 1; stage < num_stages; stage++) {
+            /* Passes with the pair distance above the group size -- global memory */
             bitonic_sort_kernel.setArg(1, static_cast<int>(stage));
-
-            /* Iterate over sub-stages */
-            for (size_t pass = 0; pass < stage + 1; pass++) {
-                /* Set pass */
+            for (size_t pass = 0; stage - pass > group_stages; pass++) {
                 bitonic_sort_kernel.setArg(2, static_cast<int>(pass));
-
-                /* Execute kernel */
-                this->queue.enqueueNDRangeKernel(bitonic_sort_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
-                this->queue.finish();
+                this->queue.enqueueNDRangeKernel(bitonic_sort_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(group_size));
             }
-        }
 
-        /* Read result */
-        this->queue.enqueueReadBuffer(this->input_buffer, CL_TRUE, 0, sizeof(decimal) * pow, arr.data());
+            /* The rest of the passes of the stage -- local memory */
+            bitonic_merge_local_kernel.setArg(1, static_cast<int>(stage));
+            this->queue.enqueueNDRangeKernel(bitonic_merge_local_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(group_size));
+        }
 
-        /* Resize back to the original size */
-        arr.resize(n);
+        /* Read result -- the padding (maximums) is at the end, only the first n elements are needed */
+        this->queue.enqueueReadBuffer(this->input_buffer.buffer, CL_TRUE, 0, sizeof(decimal) * n, arr.data());
+        this->stats.bytes_downloaded += sizeof(decimal) * n;
+        this->release_input();
 
         /* Following code is for the original merge sort kernel, which was really slow (13.5 seconds) */
 
@@ -147,29 +255,75 @@ public:
 //        this->queue.enqueueReadBuffer(this->input_buffer, CL_TRUE, 0, sizeof(decimal) * n, arr.data());
     }
 
+    /**
+     * Compute the mean absolute deviation of the array by selection on the device (hides the one of the base class)
+     * The array uploaded by the sums function is used, both medians are selected on the device and only two numbers
+     * are read back (no sort, no array of the absolute deviations) -- order matters (CV -> MAD)
+     * The results are the same as from the selection on the CPU
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+     * @param policy Execution policy (unused for GPU computations, but needed for the interface)
+     * @param arr Any array (it is not reordered)
+     * @param ws Workspace of the computation (unused, the scratch buffers are on the device)
+     * @return Mean absolute deviation
+     */
+    template<typename exec_policy>
+    [[nodiscard]] decimal compute_mad_select(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        (void) policy;  /* Supress warning about unused policy */
+        (void) ws;  /* Supress warning about unused workspace */
+
+        /* Nothing to compute (the same result as the selection on the CPU) */
+        if (arr.empty())
+            return 0;
+
+        return this->device_mad(arr);
+    }
+
+    /**
+     * Wrapper function around the selection from the selection.h file -- the selection runs on the CPU
+     * (not used by the MAD anymore -- compute_mad_select() selects on the device)
+     * This is an actual implementation of the "abstract" function in the base class
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam exec_policy Execution policy
+     * @param policy Execution policy (used for the CPU selection)
+     * @param arr Array (it is reordered by the selection)
+     * @param ws Workspace of the computation
+     * @return Lower and upper middle element of the array
+     */
+    template<typename exec_policy>
+    std::pair<decimal, decimal> select(exec_policy policy, decimal_vector &arr, workspace &ws) {
+        /* Call the selection (introselect, or the parallel quickselect) */
+        return select_middle(policy, arr, ws);
+    }
+
     /**
      * Compute absolute difference between each element and the median on the GPU
+     * Uses the array uploaded by the sums function (in its original order -- the order of the differences does not
+     * matter for their median)
      * This is an actual implementation of the "abstract" function in the base class
      * This function has to be implemented in here (.h), because of the template
      * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
      * @param policy Execution policy (unused for GPU computations, but needed for the interface)
      * @param arr Array
      * @param median Median of the array
+     * @param ws Workspace of the computation (unused, no scratch buffers needed)
      * @return Absolute difference between each element and the median
      */
     template<typename exec_policy>
-    void compute_abs_diff(exec_policy policy, const std::vector<decimal> &arr, decimal median, std::vector<decimal> &diff) {
+    void compute_abs_diff(exec_policy policy, const decimal_vector &arr, decimal median, decimal_vector &diff, workspace &ws) {
         (void) policy;  /* Supress warning about unused policy */
+        (void) ws;  /* Supress warning about unused workspace */
 
         const auto n = arr.size();
 
-        /* Create buffers */
-        cl::Buffer buffer_diff(this->context, CL_MEM_WRITE_ONLY, sizeof(decimal) * n);
+        /* Input buffer (uploaded by the sums function already) and the output buffer from the pool */
+        this->upload(arr, n);
+        auto buffer_diff = this->pool.acquire(sizeof(decimal) * n);
 
         /* Prepare kernel and arguments */
         cl::Kernel kernel(this->program, "my_abs_diff");
-        kernel.setArg(0, this->input_buffer);  /* Use the input buffer -- it should be set by the sort function */
-        kernel.setArg(1, buffer_diff);
+        kernel.setArg(0, this->input_buffer.buffer);
+        kernel.setArg(1, buffer_diff.buffer);
         kernel.setArg(2, median);
 
         /* Execute kernel */
@@ -177,7 +331,10 @@ public:
         this->queue.finish();
 
         /* Read result */
-        this->queue.enqueueReadBuffer(buffer_diff, CL_TRUE, 0, sizeof(decimal) * n, diff.data());
+        this->queue.enqueueReadBuffer(buffer_diff.buffer, CL_TRUE, 0, sizeof(decimal) * n, diff.data());
+        this->stats.bytes_downloaded += sizeof(decimal) * n;
+        this->pool.release(buffer_diff);
+        this->release_input();
     }
 
     /**
@@ -189,43 +346,67 @@ public:
      * @param arr Array
      * @param sum Sum of the array elements
      * @param sum_sq Sum of squares of the array elements
+     * @param ws Workspace of the computation
      */
     template<typename exec_policy>
-    void compute_sums(exec_policy policy, const std::vector<decimal> &arr, decimal &sum, decimal &sum_sq) {
+    void compute_sums(exec_policy policy, const decimal_vector &arr, decimal &sum, decimal &sum_sq, workspace &ws) {
         (void) policy;  /* Supress warning about unused policy */
+        (void) ws;  /* Supress warning about unused workspace (the partial sums stay on the device) */
 
         const auto n = arr.size();
 
-        /* Partial results buffer -- equivalent to local_sums in my CPU implementation */
-        std::vector<decimal> sums((n + local_size - 1) / local_size);
-        std::vector<decimal> sums_sq((n + local_size - 1) / local_size);
-
-        /* Create buffers */
-        /* Copy the array to the GPU once and keep it there */
-        this->input_buffer = cl::Buffer(this->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(decimal) * n, const_cast<decimal *>(arr.data()));
-        cl::Buffer buffer_sums(this->context, CL_MEM_WRITE_ONLY, sizeof(decimal) * sums.size());
-        cl::Buffer buffer_sums_sq(this->context, CL_MEM_WRITE_ONLY, sizeof(decimal) * sums_sq.size());
+        /* Copy the array to the GPU once and keep it there (room for the padding of the sort) -- a new series */
+        size_t pow = 1;
+        while (pow < n)
+            pow <<= 1;
+        this->release_input();
+        this->upload(arr, pow);
+        this->resident_data = arr.data();
+        this->resident_size = n;
 
-        /* Prepare kernel and arguments */
-        cl::Kernel kernel(this->program, "reduce_sum");
-        kernel.setArg(0, this->input_buffer);  /* This function creates the input buffer -- order matters (CV -> MAD) */
-        kernel.setArg(1, buffer_sums);
-        kernel.setArg(2, buffer_sums_sq);
-        kernel.setArg(3, static_cast<int>(n));
+        /* Nothing to sum */
+        if (n == 0)
+            return;
 
-        /* Execute kernel */
-        size_t global_size = ((n + local_size - 1) / local_size) * local_size;
-        this->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(local_size));
-        this->queue.finish();
+        /* Work groups of the first pass -- at most one partial sum per work item of the second pass */
+        const size_t num_vectors = (n + gpu_reduce_lanes - 1) / gpu_reduce_lanes;
+        const size_t num_groups = std::min(this->reduce_group_size, (num_vectors + this->reduce_group_size - 1) / this->reduce_group_size);
 
-        /* Read the partial results */
-        this->queue.enqueueReadBuffer(buffer_sums, CL_TRUE, 0, sizeof(decimal) * sums.size(), sums.data());
-        this->queue.enqueueReadBuffer(buffer_sums_sq, CL_TRUE, 0, sizeof(decimal) * sums_sq.size(), sums_sq.data());
+        /* Buffers of the partial results and of the final sums from the pool */
+        auto buffer_sums = this->pool.acquire(sizeof(decimal) * num_groups);
+        auto buffer_sums_sq = this->pool.acquire(sizeof(decimal) * num_groups);
+        auto buffer_results = this->pool.acquire(sizeof(decimal) * 2);
 
-        /* Sum the partial results */
-        for (size_t i = 0; i < sums.size(); i++) {
-            sum += sums[i];
-            sum_sq += sums_sq[i];
-        }
+        /* Prepare kernels and arguments */
+        cl::Kernel kernel(this->program, "reduce_sum");
+        kernel.setArg(0, this->input_buffer.buffer);  /* This function uploads the input buffer -- order matters (CV -> MAD) */
+        kernel.setArg(1, static_cast<cl_uint>(n));
+        kernel.setArg(2, buffer_sums.buffer);
+        kernel.setArg(3, buffer_sums_sq.buffer);
+        kernel.setArg(4, cl::Local(sizeof(decimal) * this->reduce_group_size));
+        kernel.setArg(5, cl::Local(sizeof(decimal) * this->reduce_group_size));
+
+        cl::Kernel final_kernel(this->program, "reduce_sum_final");
+        final_kernel.setArg(0, buffer_sums.buffer);
+        final_kernel.setArg(1, buffer_sums_sq.buffer);
+        final_kernel.setArg(2, static_cast<cl_uint>(num_groups));
+        final_kernel.setArg(3, buffer_results.buffer);
+        final_kernel.setArg(4, cl::Local(sizeof(decimal) * this->reduce_group_size));
+        final_kernel.setArg(5, cl::Local(sizeof(decimal) * this->reduce_group_size));
+
+        /* Execute kernels -- the in-order queue runs the second pass after the first one */
+        this->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(num_groups * this->reduce_group_size), cl::NDRange(this->reduce_group_size));
+        this->queue.enqueueNDRangeKernel(final_kernel, cl::NullRange, cl::NDRange(this->reduce_group_size), cl::NDRange(this->reduce_group_size));
+
+        /* Read the final sums only */
+        decimal results[2] = {0, 0};
+        this->queue.enqueueReadBuffer(buffer_results.buffer, CL_TRUE, 0, sizeof(results), results);
+        this->stats.bytes_downloaded += sizeof(results);
+        this->pool.release(buffer_sums);
+        this->pool.release(buffer_sums_sq);
+        this->pool.release(buffer_results);
+
+        sum += results[0];
+        sum_sq += results[1];
     }
 };
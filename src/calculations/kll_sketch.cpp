@@ -0,0 +1,209 @@
+#include "calculations/kll_sketch.h"
+
+#include <cmath>
+
+kll_sketch::kll_sketch(size_t k, uint64_t seed) {
+    this->reset(k, seed);
+}
+
+void kll_sketch::reset(size_t new_k, uint64_t seed) {
+    this->k = new_k;
+    this->n = 0;
+    this->size = 0;
+
+    /* Scramble the seed (splitmix64), so that close seeds (chunk indices) give unrelated sequences; never zero */
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    this->random_state = (z ^ (z >> 31)) | 1;
+
+    /* Empty all the levels, but keep their memory */
+    for (auto &level : this->levels)
+        level.clear();
+    this->num_levels = 0;
+    this->add_level();
+
+    /* Every item is taken at first */
+    this->sampler_level = 0;
+    this->block_count = 0;
+    this->block_pick = 0;
+}
+
+void kll_sketch::add_level() {
+    if (this->num_levels == this->levels.size())
+        this->levels.emplace_back();
+    this->num_levels++;
+
+    /* Capacities depend on the number of levels */
+    this->update_capacities();
+}
+
+void kll_sketch::update_capacities() {
+    this->capacities.resize(this->num_levels);
+    this->max_size = 0;
+    for (size_t h = 0; h < this->num_levels; h++) {
+        const auto depth = static_cast<double>(this->num_levels - 1 - h);
+        const auto cap = static_cast<size_t>(std::ceil(static_cast<double>(this->k) * std::pow(2.0 / 3.0, depth)));
+        this->capacities[h] = std::max<size_t>(cap, 2);
+        this->max_size += this->capacities[h];
+    }
+}
+
+void kll_sketch::merge_into(size_t level, const decimal *first, const decimal *last) {
+    auto &target = this->levels[level];
+    size_t i = target.size();
+    size_t j = static_cast<size_t>(last - first);
+    target.resize(i + j);
+
+    /* Merge from the back, in place -- the items of the level smaller than all the new ones stay where they are */
+    size_t out = target.size();
+    while (j > 0) {
+        if (i > 0 && target[i - 1] > first[j - 1])
+            target[--out] = target[--i];
+        else
+            target[--out] = first[--j];
+    }
+}
+
+size_t kll_sketch::promote(size_t level, size_t first) {
+    auto &current = this->levels[level];
+
+    /* Gather every other item at the front of the range (in place -- the reads are ahead of the writes) */
+    size_t num_promoted = 0;
+    for (size_t i = first; i < current.size(); i += 2)
+        current[first + num_promoted++] = current[i];
+
+    this->merge_into(level + 1, current.data() + first, current.data() + first + num_promoted);
+    return num_promoted;
+}
+
+void kll_sketch::compress() {
+    /* Lowest level that is full (there is one, since the sketch is full) */
+    size_t h = 0;
+    while (h < this->num_levels - 1 && this->levels[h].size() < this->capacities[h])
+        h++;
+    if (h == this->num_levels - 1)
+        this->add_level();  /* The top level is compacted -- it needs a level above it */
+
+    /* Promote every other item (random offset) of the sorted level -- an odd item out stays (the first one) */
+    auto &current = this->levels[h];
+    if (h == 0)
+        std::sort(current.begin(), current.end());
+    const size_t odd = current.size() & 1;
+    const size_t num_compacted = current.size() - odd;
+    this->promote(h, odd + this->random_bits(1));
+    current.resize(odd);
+
+    /* Half of the compacted items were promoted */
+    this->size -= num_compacted / 2;
+
+    /* Too small lowest levels are replaced by the sampler */
+    const size_t min_capacity = std::max(kll_min_capacity, this->k / kll_sampler_ratio);
+    while (this->num_levels > 1 && this->capacities[0] < min_capacity)
+        this->raise_sampler();
+}
+
+void kll_sketch::raise_sampler() {
+    /* Promote every other item (random offset) -- an odd item out is promoted with the probability of 1/2 */
+    auto &bottom = this->levels[0];
+    std::sort(bottom.begin(), bottom.end());
+    const size_t old_size = bottom.size();
+    const size_t num_promoted = this->promote(0, this->random_bits(1));
+    bottom.clear();
+    this->size = this->size - old_size + num_promoted;
+
+    /* Remove the empty level (it keeps its memory at the end) */
+    std::rotate(this->levels.begin(), this->levels.begin() + 1, this->levels.begin() + static_cast<long>(this->num_levels));
+    this->num_levels--;
+    this->update_capacities();
+
+    /* Twice as big blocks -- the current one continues with a new pick (already passed picks keep nothing) */
+    this->sampler_level++;
+    this->block_pick = this->random_bits(this->sampler_level);
+}
+
+void kll_sketch::merge(const kll_sketch &other) {
+    /* Same weights of the lowest levels -- raise the sampler of this sketch to the one of the other sketch */
+    while (this->sampler_level < other.sampler_level) {
+        if (this->num_levels == 1)
+            this->add_level();
+        this->raise_sampler();
+    }
+
+    /* Levels of the other sketch lighter than the lowest level of this one */
+    const size_t num_light = this->sampler_level - other.sampler_level;
+
+    /* Concatenate the levels of the same weight */
+    for (size_t h = num_light; h < other.num_levels; h++) {
+        const size_t target = h - num_light;
+        while (this->num_levels <= target)
+            this->add_level();
+        const auto &items = other.levels[h];
+        if (target == 0)
+            this->levels[0].insert(this->levels[0].end(), items.begin(), items.end());
+        else
+            this->merge_into(target, items.data(), items.data() + items.size());
+        this->size += items.size();
+    }
+
+    /* Items lighter than the lowest level are sampled by their weight (the sampler may rise in between) */
+    for (size_t h = 0; h < std::min(num_light, other.num_levels); h++)
+        for (const auto value : other.levels[h])
+            if (this->random_bits(this->sampler_level - other.sampler_level - h) == 0)
+                this->add(value);
+    this->n += other.n;
+
+    /* Compact until the items fit again */
+    while (this->size >= this->max_size)
+        this->compress();
+}
+
+decimal kll_sketch::quantile(double rank) {
+    if (this->size == 0)
+        return 0;
+
+    /* All the stored items with their weights, sorted */
+    this->weighted.clear();
+    size_t total = 0;
+    for (size_t h = 0; h < this->num_levels; h++) {
+        const size_t weight = static_cast<size_t>(1) << (this->sampler_level + h);
+        for (const auto value : this->levels[h])
+            this->weighted.emplace_back(value, weight);
+        total += weight * this->levels[h].size();
+    }
+    std::sort(this->weighted.begin(), this->weighted.end());
+
+    /* First item whose cumulative weight passes the wanted position (of the stored weight -- the sampler may be short) */
+    const double position = std::clamp(rank, 0.0, 1.0) * static_cast<double>(total - 1);
+    size_t cumulative = 0;
+    for (const auto &[value, weight] : this->weighted) {
+        cumulative += weight;
+        if (static_cast<double>(cumulative) > position)
+            return value;
+    }
+
+    return this->weighted.back().first;
+}
+
+decimal kll_sketch::median() {
+    if (!this->exact())
+        return this->quantile(0.5);
+    if (this->size == 0)
+        return 0;
+
+    /* All the items are in the lowest level (any order) -- the two middle ones by selection */
+    auto &items = this->levels[0];
+    const size_t half = items.size() / 2;
+    std::nth_element(items.begin(), items.begin() + static_cast<long>(half), items.end());
+    const decimal upper = items[half];
+    if (items.size() & 1)
+        return upper;
+
+    const decimal lower = *std::max_element(items.begin(), items.begin() + static_cast<long>(half));
+    return static_cast<decimal>((upper + lower) / 2.0);
+}
+
+double kll_sketch::rank_error(size_t k) {
+    /* Single-sided rank error of the KLL sketch at 99 % confidence (empirical fit of the Apache DataSketches library) */
+    return 1.854 / std::pow(static_cast<double>(k), 0.9657);
+}
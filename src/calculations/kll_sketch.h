@@ -0,0 +1,241 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "utils/utils.h"
+
+/*
+ * KLL quantile sketch (Karnin, Lang, Liberty: Optimal Quantile Approximation in Streams)
+ * A stack of compactors -- level h holds items of weight 2^(s + h); when the sketch is full, the lowest full level is
+ * sorted and every other item (random offset) is promoted to the next level with double the weight
+ * Only the lowest level takes new items in any order, the levels above it are kept sorted (the promoted items are merged
+ * into them), so a compaction costs O(capacity of the level)
+ * The capacity of the levels shrinks geometrically (factor 2/3) from the top, so the sketch keeps O(k) items no matter
+ * how many were added, and two sketches are merged simply by concatenating their levels and compacting
+ * The lowest levels that would be too small are replaced by a sampler (as in the paper): from every
+ * block of 2^s consecutive items, one random item enters the compactors -- the other items are not even read, so the
+ * update of a range costs O(n / 2^s) once the sketch has grown
+ */
+
+/** Default number of items of the top level (accuracy parameter) */
+constexpr size_t kll_default_k = 200;
+/** Smallest allowed k -- below it, the observed rank errors exceed rank_error(k) (the empirical fit does not hold) */
+constexpr size_t kll_min_k = 50;
+/** Smallest capacity of a level -- the levels below it are replaced by the sampler */
+constexpr size_t kll_min_capacity = 8;
+/** The levels with capacity below k / kll_sampler_ratio are replaced by the sampler too -- their error is small compared
+ * to the one of the top levels (the error contributed by a level falls geometrically with its depth) */
+constexpr size_t kll_sampler_ratio = 16;
+
+/**
+ * Mergeable quantile sketch (KLL)
+ * The rank of a quantile returned by the sketch differs from the wanted one by about rank_error(k) * n at most (with
+ * 99 % confidence), the memory does not grow with n
+ */
+class kll_sketch {
+private:
+    /** Accuracy parameter -- capacity of the top level */
+    size_t k = kll_default_k;
+    /** Number of items added to the sketch */
+    size_t n = 0;
+    /** Number of items stored in all the levels */
+    size_t size = 0;
+    /** Number of items the levels can hold before the sketch is compacted */
+    size_t max_size = 0;
+    /** Number of levels in use (the vectors of the unused levels keep their capacity for the next reset()) */
+    size_t num_levels = 0;
+    /** Levels of the sketch -- items of the level h have the weight 2^(sampler_level + h) */
+    std::vector<std::vector<decimal>> levels;
+    /** Capacities of the levels in use (they depend on the number of levels) */
+    std::vector<size_t> capacities;
+    /** Level of the sampler -- one item of each block of 2^sampler_level items is kept */
+    size_t sampler_level = 0;
+    /** Number of items of the current block seen so far */
+    size_t block_count = 0;
+    /** Index of the item of the current block that is kept */
+    size_t block_pick = 0;
+    /** State of the random generator (xorshift64) */
+    uint64_t random_state = 1;
+    /** Items with their weights, sorted (quantile queries) */
+    std::vector<std::pair<decimal, size_t>> weighted;
+
+    /**
+     * Recompute the capacities of the levels and their total
+     * The capacity of a level is k * (2/3)^depth (depth = levels above it), at least 2
+     */
+    void update_capacities();
+
+    /**
+     * Add a new empty level on the top of the sketch
+     */
+    void add_level();
+
+    /**
+     * Merge sorted items into a level above the lowest one (those are kept sorted)
+     * @param level Level (at least 1)
+     * @param first First item
+     * @param last Past the last item
+     */
+    void merge_into(size_t level, const decimal *first, const decimal *last);
+
+    /**
+     * Promote every other item of a sorted level into the next one (the promoted items are moved to first, first + 1, ...
+     * of the level before the merge)
+     * @param level Level (sorted)
+     * @param first Index of the first promoted item
+     * @return Number of promoted items
+     */
+    size_t promote(size_t level, size_t first);
+
+    /**
+     * Compact the lowest full level into the next one (halves its weight, doubles the weight of the promoted items),
+     * then replace the lowest levels by the sampler, while they are too small (kll_min_capacity, kll_sampler_ratio)
+     */
+    void compress();
+
+    /**
+     * Compact the lowest level entirely into the next one and remove it -- the sampler takes its place
+     */
+    void raise_sampler();
+
+    /**
+     * Add an item that passed the sampler to the lowest level
+     * @param value Item
+     */
+    void add(decimal value) {
+        this->levels[0].push_back(value);
+        if (++this->size >= this->max_size)
+            this->compress();
+    }
+
+    /**
+     * Next random number (xorshift64)
+     * @return Random number
+     */
+    uint64_t next_random() {
+        this->random_state ^= this->random_state << 13;
+        this->random_state ^= this->random_state >> 7;
+        this->random_state ^= this->random_state << 17;
+        return this->random_state;
+    }
+
+    /**
+     * Random number with the given number of bits (the top bits of the generator)
+     * @param bits Number of bits (at most 64)
+     * @return Random number in [0, 2^bits)
+     */
+    size_t random_bits(size_t bits) {
+        return bits == 0 ? 0 : static_cast<size_t>(this->next_random() >> (64 - bits));
+    }
+
+public:
+    /**
+     * Constructor
+     * @param k Accuracy parameter (at least kll_min_k)
+     * @param seed Seed of the random generator (the same seed and data give the same sketch)
+     */
+    explicit kll_sketch(size_t k = kll_default_k, uint64_t seed = 1);
+
+    /**
+     * Empty the sketch, keep the allocated levels (reuse in the workspace)
+     * @param new_k Accuracy parameter (at least kll_min_k)
+     * @param seed Seed of the random generator
+     */
+    void reset(size_t new_k, uint64_t seed);
+
+    /**
+     * Add the transformed items of a range to the sketch -- only the items picked by the sampler are read
+     * This function has to be implemented in here (.h), because of the template
+     * @tparam transform Function applied to every picked item (decimal(decimal))
+     * @param arr Start of the range
+     * @param count Number of items
+     * @param fn Function applied to every picked item
+     */
+    template <typename transform>
+    void update_range(const decimal *arr, size_t count, transform fn) {
+        size_t i = 0;
+        while (i < count) {
+            /* Rest of the current block, or of the range */
+            const size_t block_size = static_cast<size_t>(1) << this->sampler_level;
+            const size_t step = std::min(block_size - this->block_count, count - i);
+            const bool take = this->block_pick >= this->block_count && this->block_pick < this->block_count + step;
+            const decimal value = take ? fn(arr[i + this->block_pick - this->block_count]) : 0;
+
+            i += step;
+            this->n += step;
+            this->block_count += step;
+            if (this->block_count == block_size) {
+                /* New block -- pick its random item */
+                this->block_count = 0;
+                this->block_pick = this->random_bits(this->sampler_level);
+            }
+
+            /* May raise the sampler (the next blocks are bigger) */
+            if (take)
+                this->add(value);
+        }
+    }
+
+    /**
+     * Add an item to the sketch
+     * @param value Item
+     */
+    void update(decimal value) {
+        this->update_range(&value, 1, [](decimal val) { return val; });
+    }
+
+    /**
+     * Merge another sketch into this one (both must have the same k)
+     * @param other Sketch to be merged
+     */
+    void merge(const kll_sketch &other);
+
+    /**
+     * Estimate the quantile of the added items
+     * @param rank Normalized rank (0 = the smallest, 1 = the largest)
+     * @return Item with (approximately) the given rank
+     */
+    [[nodiscard]] decimal quantile(double rank);
+
+    /**
+     * Estimate the median of the added items
+     * While nothing was compacted or sampled away (every item stored with the weight 1), the median is exact -- the mean
+     * of the two middle items, as in the exact MAD
+     * @return Median of the added items (approximate once the sketch was compacted)
+     */
+    [[nodiscard]] decimal median();
+
+    /**
+     * Whether the sketch holds all the added items (nothing compacted, nothing skipped by the sampler)
+     * @return True if the quantiles are exact
+     */
+    [[nodiscard]] bool exact() const {
+        return this->size == this->n;
+    }
+
+    /**
+     * Number of items added to the sketch
+     * @return Number of items
+     */
+    [[nodiscard]] size_t count() const {
+        return this->n;
+    }
+
+    /**
+     * Number of items stored in the sketch (memory)
+     * @return Number of stored items
+     */
+    [[nodiscard]] size_t stored() const {
+        return this->size;
+    }
+
+    /**
+     * A priori normalized rank error of the quantiles (99 % confidence), the empirical bound of the KLL sketch
+     * @param k Accuracy parameter
+     * @return Rank error as a fraction of the number of items
+     */
+    [[nodiscard]] static double rank_error(size_t k);
+};
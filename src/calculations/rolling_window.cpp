@@ -0,0 +1,35 @@
+#include "calculations/rolling_window.h"
+
+#include <algorithm>
+
+size_t rolling_window::first_row(const std::vector<int64_t> &times, size_t row) const {
+    if (!this->by_time())
+        return row + 1 > this->samples ? row + 1 - this->samples : 0;
+
+    /* First row after the (exclusive) start of the window -- the current row is always inside (span > 0) */
+    const auto last = times.begin() + static_cast<long>(row);
+    return static_cast<size_t>(std::upper_bound(times.begin(), last, times[row] - this->span) - times.begin());
+}
+
+void rank_tree::reset(size_t num_ranks) {
+    this->tree.assign(num_ranks + 1, 0);
+    this->count = 0;
+
+    this->top = 1;
+    while (this->top * 2 <= num_ranks)
+        this->top *= 2;
+}
+
+size_t rank_tree::select(size_t k) const {
+    /* Largest position whose prefix count is at most k -- the wanted rank is the next one */
+    size_t position = 0;
+    for (size_t step = this->top; step > 0; step /= 2) {
+        const size_t next = position + step;
+        if (next < this->tree.size() && this->tree[next] <= k) {
+            position = next;
+            k -= this->tree[next];
+        }
+    }
+
+    return position;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "utils/utils.h"
+
+/*
+ * Rolling window statistics
+ * The values of the whole column are ranked once (sorted distinct values), then the window keeps only the counts of the
+ * ranks in a Fenwick tree -- adding or removing a value is O(log u), the i-th smallest value of the window is one descent
+ * of the tree, O(log u) (u = number of distinct values of the column)
+ * So the median is two descents and the MAD is the binary search of kth_abs_deviation over the window seen as a sorted
+ * array, O(log w * log u) per step instead of the O(w log w) of sorting every window
+ */
+
+/**
+ * Window of the rolling statistics -- either the last samples, or the last microseconds up to the current row
+ */
+struct rolling_window {
+    /** Number of samples of the window (0 = the window is given by time, see span) */
+    size_t samples = 0;
+    /** Length of the window in microseconds -- rows with the timestamp in (t - span, t] of the current row t */
+    int64_t span = 0;
+
+    /**
+     * Whether the window is given by time (the timestamps are needed then)
+     * @return True if the window is given by time
+     */
+    [[nodiscard]] bool by_time() const {
+        return this->samples == 0;
+    }
+
+    /**
+     * First row of the window of the given row (binary search of the timestamps, O(log n))
+     * @param times Timestamps of the rows, sorted (used only if the window is given by time)
+     * @param row Current (last) row of the window
+     * @return First row of the window
+     */
+    [[nodiscard]] size_t first_row(const std::vector<int64_t> &times, size_t row) const;
+
+    /**
+     * First row of the window of the given row, knowing the first row of a previous window -- the windows only move
+     * forward, so the search starts from there (amortized O(1) per row)
+     * @param times Timestamps of the rows, sorted (used only if the window is given by time)
+     * @param row Current (last) row of the window
+     * @param first First row of the window of a previous row
+     * @return First row of the window
+     */
+    [[nodiscard]] size_t advance(const std::vector<int64_t> &times, size_t row, size_t first) const {
+        if (!this->by_time())
+            return this->first_row(times, row);
+
+        /* The current row is always inside (span > 0) */
+        while (times[first] <= times[row] - this->span)
+            first++;
+        return first;
+    }
+};
+
+/**
+ * Counts of the ranks of the values in a window (Fenwick tree) -- an order statistic multiset of the ranks
+ */
+class rank_tree {
+private:
+    /** Fenwick tree of the counts -- node i holds the count of the ranks (i - lowbit(i), i] (1-based) */
+    std::vector<uint32_t> tree;
+    /** Largest power of two not above the number of ranks (first step of the descent) */
+    size_t top = 0;
+    /** Number of values in the tree */
+    size_t count = 0;
+
+public:
+    /**
+     * Empty the tree for the given number of ranks (keeps the memory of the tree)
+     * @param num_ranks Number of distinct ranks (0 to num_ranks - 1)
+     */
+    void reset(size_t num_ranks);
+
+    /**
+     * Add a value of the given rank
+     * @param rank Rank of the value
+     */
+    void insert(size_t rank) {
+        for (size_t i = rank + 1; i < this->tree.size(); i += i & (~i + 1))
+            this->tree[i]++;
+        this->count++;
+    }
+
+    /**
+     * Remove a value of the given rank (it must be in the tree)
+     * @param rank Rank of the value
+     */
+    void erase(size_t rank) {
+        for (size_t i = rank + 1; i < this->tree.size(); i += i & (~i + 1))
+            this->tree[i]--;
+        this->count--;
+    }
+
+    /**
+     * Rank of the k-th smallest value in the tree (descent of the tree -- no prefix sums)
+     * @param k Index of the value (0 = the smallest, k < size())
+     * @return Rank of the value
+     */
+    [[nodiscard]] size_t select(size_t k) const;
+
+    /**
+     * Number of values in the tree
+     * @return Number of values
+     */
+    [[nodiscard]] size_t size() const {
+        return this->count;
+    }
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <execution>
+
+#include "calculations/workspace.h"
+#include "utils/utils.h"
+
+/*
+ * Selection of the middle elements (median) without sorting the whole array
+ * Sequential: std::nth_element (introselect -- quickselect with a median of three pivot, heapselect fallback), O(n)
+ * Parallel: quickselect, where each round is one parallel partition of the candidates -- the threads count the elements
+ * less than / equal to the pivot in their chunks, the prefix sums give each thread its output offset and only the
+ * part that contains the k-th element is scattered into a scratch buffer; small ranges finish by std::nth_element
+ * The pivot is taken from an evenly spaced sample at the rank of k, so the candidates shrink quickly
+ */
+
+/** Below this number of candidates, the selection continues sequentially (std::nth_element) */
+constexpr size_t parallel_select_threshold = 1 << 15;
+/** Number of elements sampled for the pivot of the parallel selection */
+constexpr size_t select_sample_size = 127;
+
+/**
+ * Find the k-th smallest element of the array and the element right before it (the (k-1)-th smallest)
+ * The array may be reordered (like a partial sort), the result is exactly the same as arr[k], arr[k-1] after a sort
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param arr Array (not empty, k < arr.size())
+ * @param k Rank of the wanted element (0 = the smallest)
+ * @param kth The k-th smallest element (output)
+ * @param predecessor The (k-1)-th smallest element (output, only valid if k > 0)
+ * @param ws Workspace (candidates, chunk indices, counts)
+ */
+template <typename exec_policy>
+void select_kth(exec_policy policy, decimal_vector &arr, size_t k, decimal &kth, decimal &predecessor, workspace &ws) {
+    constexpr bool parallel = !std::is_same_v<std::decay_t<exec_policy>, std::execution::sequenced_policy>;
+
+    /* Current candidates -- the whole array first, then the scratch buffers (ping-pong) */
+    decimal *candidates = arr.data();
+    size_t num_candidates = arr.size();
+    size_t buffer = 0;
+
+    /* Largest element known to be smaller than all the candidates (the predecessor, if k drops to 0) */
+    decimal below = std::numeric_limits<decimal>::lowest();
+
+    /*
+     * Room for the worst case in both scratch buffers (all the candidates but the pivot kept) -- how many are kept depends
+     * on the data, so the buffers would otherwise grow again whenever the data changes
+     */
+    if (parallel && num_candidates > parallel_select_threshold)
+        for (auto &scratch : ws.candidates)
+            if (scratch.capacity() < num_candidates) {
+                ws.allocations++;
+                scratch.reserve(num_candidates);
+            }
+
+    while (parallel && num_candidates > parallel_select_threshold) {
+        /* Pivot -- sample element at (approximately) the same rank as k */
+        decimal sample[select_sample_size];
+        for (size_t i = 0; i < select_sample_size; i++)
+            sample[i] = candidates[i * (num_candidates - 1) / (select_sample_size - 1)];
+        const size_t sample_rank = std::min(k * select_sample_size / num_candidates, select_sample_size - 1);
+        std::nth_element(sample, sample + sample_rank, sample + select_sample_size);
+        const decimal pivot = sample[sample_rank];
+
+        /* Prepare for parallelism */
+        const auto max_num_threads = std::thread::hardware_concurrency();
+        const size_t chunk_size = num_candidates / max_num_threads;
+        auto &chunk_indices = use_buffer(ws, ws.indices, max_num_threads);
+        std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+        auto &less = use_buffer(ws, ws.counters[0], max_num_threads + 1);
+        auto &equal = use_buffer(ws, ws.counters[1], max_num_threads + 1);
+        auto &less_max = use_buffer(ws, ws.partials[0], max_num_threads);
+        less[0] = equal[0] = 0;
+
+        /* First pass -- count the elements less than and equal to the pivot in each chunk */
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+            const size_t start = i * chunk_size;
+            /* Final thread may have to handle a little more elements */
+            const size_t end = (i == max_num_threads - 1) ? num_candidates : start + chunk_size;
+
+            size_t num_less = 0, num_equal = 0;
+            decimal max_less = std::numeric_limits<decimal>::lowest();
+            for (size_t j = start; j < end; j++) {
+                const decimal val = candidates[j];
+                num_less += val < pivot;
+                num_equal += val == pivot;
+                if (val < pivot)
+                    max_less = std::max(max_less, val);
+            }
+            less[i + 1] = num_less;
+            equal[i + 1] = num_equal;
+            less_max[i] = max_less;
+        });
+
+        /* Prefix sums -- less[i] and equal[i] are now the numbers of such elements before chunk i */
+        std::partial_sum(less.begin(), less.end(), less.begin());
+        std::partial_sum(equal.begin(), equal.end(), equal.begin());
+        const size_t total_less = less[max_num_threads];
+        const size_t total_equal = equal[max_num_threads];
+
+        /* The k-th element is the pivot itself -- done */
+        if (k >= total_less && k < total_less + total_equal) {
+            kth = pivot;
+            predecessor = k > total_less ? pivot : std::max(below, *std::max_element(less_max.begin(), less_max.end()));
+            return;
+        }
+
+        /* Keep only the elements less than the pivot, or only the elements greater than the pivot */
+        const bool keep_less = k < total_less;
+        const size_t num_kept = keep_less ? total_less : num_candidates - total_less - total_equal;
+        if (!keep_less) {
+            k -= total_less + total_equal;
+            below = pivot;
+        }
+
+        /* Second pass -- scatter the kept elements, each chunk to its own offset (no synchronization needed) */
+        decimal *kept = use_buffer(ws, ws.candidates[buffer], num_kept).data();
+        std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+            const size_t start = i * chunk_size;
+            const size_t end = (i == max_num_threads - 1) ? num_candidates : start + chunk_size;
+
+            /* Offset of the chunk -- greater elements before the chunk = all elements before it - less - equal */
+            size_t offset = keep_less ? less[i] : start - less[i] - equal[i];
+            for (size_t j = start; j < end; j++) {
+                const decimal val = candidates[j];
+                if (keep_less ? val < pivot : val > pivot)
+                    kept[offset++] = val;
+            }
+        });
+
+        candidates = kept;
+        num_candidates = num_kept;
+        buffer ^= 1;
+    }
+
+    /* Sequential finish (or the whole sequential selection) -- introselect */
+    std::nth_element(candidates, candidates + k, candidates + num_candidates);
+    kth = candidates[k];
+    predecessor = k ? std::max(below, *std::max_element(candidates, candidates + k)) : below;
+}
+
+/**
+ * Find the two middle elements of the array -- the elements at (n - 1) / 2 and n / 2 after a sort
+ * (the same element twice for an odd size), so that the median is computed exactly as from the sorted array
+ * The array may be reordered (like a partial sort)
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param arr Array
+ * @param ws Workspace (candidates, chunk indices, counts)
+ * @return Lower and upper middle element (zeros for an empty array)
+ */
+template <typename exec_policy>
+std::pair<decimal, decimal> select_middle(exec_policy policy, decimal_vector &arr, workspace &ws) {
+    if (arr.empty())
+        return {0, 0};
+
+    decimal upper, lower;
+    select_kth(policy, arr, arr.size() / 2, upper, lower, ws);
+    return {(arr.size() & 1) ? upper : lower, upper};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "calculations/kll_sketch.h"
+#include "calculations/rolling_window.h"
+#include "utils/utils.h"
+
+/**
+ * Scratch workspace of the computations -- grow-only buffers reused between the calls
+ * Every backend instance owns one (computations class) and passes it to the sorts and the selection, so once the buffers
+ * have grown to the size of the data, the computations do not allocate anything at all
+ * The buffers do not keep any contents between the calls, every user takes them as uninitialized memory
+ */
+struct workspace {
+    /** Scratch buffer of the sorts (its storage is swapped with the sorted array) */
+    decimal_vector scratch;
+    /** Absolute differences from the median (MAD by selection) */
+    decimal_vector diff;
+    /** Candidates of the parallel selection (ping-pong) */
+    decimal_vector candidates[2];
+    /** Partial results of the chunks (sums, sums of squares, maxima, samples, ...) */
+    std::vector<decimal> partials[2];
+    /** Indices of the chunks for std::for_each */
+    std::vector<size_t> indices;
+    /** Counters of the chunks (histograms, offsets, ...) */
+    std::vector<size_t> counters[2];
+    /** Quantile sketches of the chunks (approximate MAD) */
+    std::vector<kll_sketch> sketches;
+    /** Counts of the ranks in the windows of the chunks (rolling statistics) */
+    std::vector<rank_tree> trees;
+    /** Number of allocations made by the buffers so far (a buffer allocates only when it grows) */
+    size_t allocations = 0;
+};
+
+/**
+ * Resize the buffer of the workspace to the given number of elements -- allocates only if its capacity is not enough
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam vector_type Type of the buffer (std::vector or decimal_vector)
+ * @param ws Workspace (counts the allocations)
+ * @param buffer Buffer of the workspace
+ * @param n Number of elements
+ * @return The buffer
+ */
+template <typename vector_type>
+vector_type &use_buffer(workspace &ws, vector_type &buffer, size_t n) {
+    if (buffer.capacity() < n)
+        ws.allocations++;
+    buffer.resize(n);
+    return buffer;
+}
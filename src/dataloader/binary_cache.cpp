@@ -0,0 +1,255 @@
+#include "dataloader/binary_cache.h"
+
+#include <cstddef>
+#include <filesystem>
+
+/** Magic bytes of the cache file */
+constexpr char cache_magic[8] = {'P', 'P', 'R', 'C', 'A', 'C', 'H', 'E'};
+/** Version of the cache format */
+constexpr uint32_t cache_version = 2;
+
+static_assert(sizeof(cache_header) <= cache_header_size, "Cache header does not fit into its reserved space");
+
+/** Multiplier constants of the checksum (64-bit primes from xxHash) */
+constexpr uint64_t checksum_prime_1 = 0x9E3779B185EBCA87ULL;
+/** Multiplier constants of the checksum (64-bit primes from xxHash) */
+constexpr uint64_t checksum_prime_2 = 0xC2B2AE3D27D4EB4FULL;
+
+/**
+ * Rotate the bits to the left
+ * @param value Value
+ * @param bits Number of bits
+ * @return Rotated value
+ */
+static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * One step of a checksum lane -- mix the next 8 bytes into the accumulator
+ * @param acc Accumulator
+ * @param word Next 8 bytes
+ * @return New accumulator
+ */
+static uint64_t checksum_round(uint64_t acc, uint64_t word) {
+    return rotate_left(acc + word * checksum_prime_2, 31) * checksum_prime_1;
+}
+
+uint64_t compute_checksum(const char *data, size_t size) {
+    uint64_t lanes[4] = {checksum_prime_1 + checksum_prime_2, checksum_prime_2, 0, 0 - checksum_prime_1};
+    size_t i = 0;
+
+    /* 32 bytes per step, four independent lanes (no dependency chain between them) */
+    for (; i + 32 <= size; i += 32)
+        for (size_t lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * lane, sizeof(word));
+            lanes[lane] = checksum_round(lanes[lane], word);
+        }
+
+    /* Merge the lanes */
+    uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+    hash ^= size;
+
+    /* Remaining bytes */
+    for (; i < size; i++)
+        hash = rotate_left(hash ^ static_cast<unsigned char>(data[i]), 11) * checksum_prime_1;
+
+    /* Final avalanche */
+    hash ^= hash >> 33;
+    hash *= checksum_prime_2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+/**
+ * Checksum of the whole file (memory mapped)
+ * @param filepath Path to the file
+ * @param checksum Checksum (output)
+ * @return False if the file cannot be read (the cache is not used then)
+ */
+static bool compute_file_checksum(const std::string &filepath, uint64_t &checksum) {
+    mapped_file file;
+    if (!try_map_file(filepath, file))
+        return false;
+    checksum = compute_checksum(file.data, file.size);
+    unmap_file(file);
+    return true;
+}
+
+/**
+ * Last modification time of the file
+ * @param filepath Path to the file
+ * @return Modification time in file clock ticks (0 if it cannot be read)
+ */
+static int64_t modification_time(const std::string &filepath) {
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(filepath, error);
+    return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+/**
+ * Round the offset up to the cache alignment
+ * @param offset Offset
+ * @return Aligned offset
+ */
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + cache_alignment - 1) / cache_alignment * cache_alignment;
+}
+
+/**
+ * Rewrite the modification time of the source file in the header of the cache (in place, the rest stays the same)
+ * Failing to do so is not an error -- the checksum is just computed again next time
+ * @param path Path to the cache file
+ * @param source_mtime New modification time of the source file
+ */
+static void update_source_mtime(const std::string &path, int64_t source_mtime) {
+    FILE *fp = fopen(path.c_str(), "r+b");
+    if (!fp)
+        return;
+    if (fseek(fp, offsetof(cache_header, source_mtime), SEEK_SET) == 0)
+        fwrite(&source_mtime, sizeof(source_mtime), 1, fp);
+    fclose(fp);
+}
+
+std::string cache_path(const std::string &filepath) {
+    return filepath + cache_extension;
+}
+
+bool is_cache_file(const std::string &filepath) {
+    /* Also covers the temporary files of an interrupted write */
+    return std::filesystem::path(filepath).filename().string().find(cache_extension) != std::string::npos;
+}
+
+bool load_data_cache(const std::string &filepath, patient_data &data, bool with_time) {
+    /* Nothing here fails the program -- a missing, unreadable or broken cache just means parsing the source file */
+    const std::string path = cache_path(filepath);
+    std::error_code error;
+    const auto source_size = std::filesystem::file_size(filepath, error);
+    if (error)
+        return false;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error || size < cache_header_size)
+        return false;
+
+    /* Map the cache (it may have changed since its size was read) */
+    mapped_file file;
+    if (!try_map_file(path, file))
+        return false;
+    if (file.size < cache_header_size) {
+        unmap_file(file);
+        return false;
+    }
+
+    cache_header header{};
+    memcpy(&header, file.data, sizeof(header));
+
+    /* Check that the cache belongs to this build and this source file */
+    bool valid = memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 && header.version == cache_version
+                 && header.decimal_size == sizeof(decimal) && header.source_size == source_size;
+
+    /* The columns fit into the file -- the number of rows is checked first, so a corrupt one cannot overflow the sizes */
+    valid = valid && header.num_rows <= file.size / sizeof(decimal);
+    for (const auto offset : header.column_offsets)
+        valid = valid && offset % cache_alignment == 0 && offset <= file.size && header.num_rows * sizeof(decimal) <= file.size - offset;
+    if (header.time_offset)
+        valid = valid && header.time_offset % cache_alignment == 0 && header.num_rows <= file.size / sizeof(int64_t)
+                && header.time_offset <= file.size && header.num_rows * sizeof(int64_t) <= file.size - header.time_offset;
+    else
+        valid = valid && !with_time;
+
+    /* Same size, but touched since -- only the checksum can tell whether the content is still the same */
+    const int64_t source_mtime = modification_time(filepath);
+    bool touched = false;
+    if (valid && header.source_mtime != source_mtime) {
+        uint64_t checksum = 0;
+        valid = compute_file_checksum(filepath, checksum) && header.source_checksum == checksum;
+        touched = valid;
+    }
+
+    if (valid) {
+        /* Clean the data and copy the columns straight out of the mapping */
+        decimal_vector *columns[3] = {&data.x, &data.y, &data.z};
+        for (size_t i = 0; i < 3; i++) {
+            const auto *column = reinterpret_cast<const decimal *>(file.data + header.column_offsets[i]);
+            columns[i]->assign(column, column + header.num_rows);
+        }
+
+        /* Timestamps only if they are wanted */
+        data.t.clear();
+        if (with_time) {
+            const auto *timestamps = reinterpret_cast<const int64_t *>(file.data + header.time_offset);
+            data.t.assign(timestamps, timestamps + header.num_rows);
+        }
+    }
+
+    unmap_file(file);
+
+    /* Same content -- store the new modification time, so that the next runs skip the checksum again */
+    if (touched)
+        update_source_mtime(path, source_mtime);
+    return valid;
+}
+
+void save_data_cache(const std::string &filepath, const patient_data &data) {
+    const std::string path = cache_path(filepath);
+
+    /* Prepare the header */
+    cache_header header{};
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.decimal_size = sizeof(decimal);
+    header.num_rows = data.x.size();
+    header.source_mtime = modification_time(filepath);
+    std::error_code size_error;
+    header.source_size = std::filesystem::file_size(filepath, size_error);
+    if (size_error || !compute_file_checksum(filepath, header.source_checksum)) {
+        std::cerr << "Error writing cache file: " << path << std::endl;
+        return;
+    }
+
+    /* Columns one after another, each one 64-byte aligned */
+    const uint64_t column_bytes = header.num_rows * sizeof(decimal);
+    header.column_offsets[0] = cache_header_size;
+    header.column_offsets[1] = align_offset(header.column_offsets[0] + column_bytes);
+    header.column_offsets[2] = align_offset(header.column_offsets[1] + column_bytes);
+    const bool with_time = !data.t.empty();
+    header.time_offset = with_time ? align_offset(header.column_offsets[2] + column_bytes) : 0;
+
+    /* Write to a temporary file first, so that a half-written cache is never picked up */
+    const std::string temp_path = path + ".tmp";
+    FILE *out_fp = fopen(temp_path.c_str(), "wb");
+    if (!out_fp) {
+        std::cerr << "Error writing cache file: " << path << std::endl;
+        return;
+    }
+
+    char header_block[cache_header_size] = {};
+    memcpy(header_block, &header, sizeof(header));
+    bool ok = fwrite(header_block, 1, cache_header_size, out_fp) == cache_header_size;
+
+    const decimal_vector *columns[3] = {&data.x, &data.y, &data.z};
+    uint64_t position = cache_header_size;
+    for (size_t i = 0; i < 3 && ok; i++) {
+        /* Zero padding up to the aligned offset */
+        const char padding[cache_alignment] = {};
+        ok = fwrite(padding, 1, header.column_offsets[i] - position, out_fp) == header.column_offsets[i] - position;
+        ok = ok && fwrite(columns[i]->data(), 1, column_bytes, out_fp) == column_bytes;
+        position = header.column_offsets[i] + column_bytes;
+    }
+    if (with_time && ok) {
+        const char padding[cache_alignment] = {};
+        ok = fwrite(padding, 1, header.time_offset - position, out_fp) == header.time_offset - position;
+        ok = ok && fwrite(data.t.data(), sizeof(int64_t), data.t.size(), out_fp) == data.t.size();
+    }
+    ok = fclose(out_fp) == 0 && ok;
+
+    /* Replace the old cache (if any) */
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(temp_path, path, error);
+    if (!ok || error) {
+        std::cerr << "Error writing cache file: " << path << std::endl;
+        std::filesystem::remove(temp_path, error);
+    }
+}
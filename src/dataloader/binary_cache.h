@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "dataloader/dataloader.h"
+#include "utils/utils.h"
+
+/*
+ * Binary columnar cache (sidecar file next to the CSV file)
+ * Layout: header (cache_header_size bytes), then the X, Y and Z columns (and the timestamps, if they were loaded),
+ * each one starting at a 64-byte aligned offset
+ * The header stores the number of rows, the decimal width (float / double build) and the size, modification time
+ * and checksum of the source CSV file, so that a stale or foreign cache is never used
+ */
+
+/** Extension of the cache file (appended to the full name of the source file) */
+constexpr char cache_extension[] = ".pprc";
+/** Alignment of the columns in the cache file */
+constexpr size_t cache_alignment = 64;
+/** Size of the header -- the first column starts right after it */
+constexpr size_t cache_header_size = 2 * cache_alignment;
+
+/**
+ * Header of the cache file
+ */
+struct cache_header {
+    /** Magic bytes identifying the file format */
+    char magic[8];
+    /** Version of the format */
+    uint32_t version;
+    /** Size of one value in bytes (sizeof(decimal) of the build that wrote the file) */
+    uint32_t decimal_size;
+    /** Number of rows (values per column) */
+    uint64_t num_rows;
+    /** Size of the source file in bytes */
+    uint64_t source_size;
+    /** Last modification time of the source file (file clock ticks) */
+    int64_t source_mtime;
+    /** Checksum of the whole source file */
+    uint64_t source_checksum;
+    /** Offsets of the X, Y and Z columns from the start of the file (64-byte aligned) */
+    uint64_t column_offsets[3];
+    /** Offset of the timestamp column (64-byte aligned), 0 if the cache does not contain the timestamps */
+    uint64_t time_offset;
+};
+
+/**
+ * Fast 64-bit checksum of the buffer (four independent multiply-rotate lanes, 32 bytes per step)
+ * @param data Buffer
+ * @param size Size of the buffer in bytes
+ * @return Checksum
+ */
+uint64_t compute_checksum(const char *data, size_t size);
+
+/**
+ * Path of the cache file that belongs to the source file
+ * @param filepath Path to the source (CSV) file
+ * @return Path to the cache file
+ */
+std::string cache_path(const std::string &filepath);
+
+/**
+ * Check whether the file is a cache file (so that it is not processed as a data file)
+ * @param filepath Path to the file
+ * @return Whether the file name contains the cache extension
+ */
+bool is_cache_file(const std::string &filepath);
+
+/**
+ * Load data from the cache file of the source file, if there is a valid one
+ * The cache is memory mapped and the columns are copied straight out of the mapping
+ * The cache is valid if it was written by a build with the same decimal width for a source file of the same size
+ * and the same modification time (if the modification time differs, the checksum of the source file decides
+ * and a matching one stores the new modification time in the cache)
+ * @param filepath Path to the source (CSV) file
+ * @param data Data structure to store the loaded data
+ * @param with_time Whether the timestamps are needed (a cache without them is not valid then)
+ * @return Whether the data were loaded from the cache
+ */
+bool load_data_cache(const std::string &filepath, patient_data &data, bool with_time = false);
+
+/**
+ * Write the cache file for the source file (errors are only reported, the cache is optional)
+ * The timestamps are stored only if they were loaded (data.t is not empty)
+ * @param filepath Path to the source (CSV) file
+ * @param data Data loaded from the source file
+ */
+void save_data_cache(const std::string &filepath, const patient_data &data);
@@ -0,0 +1,41 @@
+#include "dataloader/csv_scanner.h"
+
+#include <algorithm>
+
+#include "simd/simd_kernels.h"
+
+/** Number of bytes indexed at once by index_char -- the positions of a segment stay in the cache (32 KB at most) */
+constexpr size_t index_segment_size = 1 << 12;
+
+size_t count_char(const char *begin, const char *end, char c) {
+    return get_simd_kernels().count_char(begin, end, c);
+}
+
+const char *find_char(const char *begin, const char *end, char c) {
+    return get_simd_kernels().find_char(begin, end, c);
+}
+
+void index_char(const char *begin, const char *end, char c, std::vector<size_t> &positions) {
+    const auto &kernels = get_simd_kernels();
+    positions.clear();
+
+    /* Room for the expected positions (one per 16 bytes) -- only reserved, the positions are appended (no zero-filling) */
+    positions.reserve(static_cast<size_t>(end - begin) / 16);
+
+    /* Raw output of one segment -- there is always room for all of its positions (not initialized, written by the kernel) */
+    size_t segment_positions[index_segment_size];
+
+    for (const char *segment = begin; segment < end; segment += index_segment_size) {
+        const char *segment_end = std::min(segment + index_segment_size, end);
+
+        /* Positions within the segment, appended as the positions within the buffer */
+        const size_t found = kernels.index_char(segment, segment_end, c, segment_positions);
+        const size_t offset = segment - begin;
+        for (size_t i = 0; i < found; i++)
+            positions.push_back(segment_positions[i] + offset);
+    }
+}
+
+size_t find_commas(const char *line, const char *end, const char **commas, size_t max_commas) {
+    return get_simd_kernels().find_commas(line, end, commas, max_commas);
+}
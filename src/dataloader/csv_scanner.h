@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Structural scanner for the CSV files (in the style of simdcsv)
+ * Instead of walking the buffer byte by byte, one register of bytes is compared at once (16 bytes with SSE4.2,
+ * 32 with AVX2, 64 with AVX-512BW -- the kernels of the best instruction set of the CPU, simd_kernels.h)
+ * and the result is compressed into a mask, one bit per byte
+ * The positions of the structural characters ('\n' and ',') are then extracted from the masks
+ */
+
+/**
+ * Count occurrences of the character in the buffer (one register at a time)
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to count
+ * @return Number of occurrences
+ */
+size_t count_char(const char *begin, const char *end, char c);
+
+/**
+ * Find the first occurrence of the character in the buffer (one register at a time)
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to look for
+ * @return Pointer to the first occurrence, or end if there is none
+ */
+const char *find_char(const char *begin, const char *end, char c);
+
+/**
+ * Build the structural index of the buffer -- positions (offsets from begin) of all occurrences of the character
+ * The masks are flattened into positions with the trailing zero count, without any per-byte branching
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to look for
+ * @param positions Positions of all occurrences (output, previous content is cleared)
+ */
+void index_char(const char *begin, const char *end, char c, std::vector<size_t> &positions);
+
+/**
+ * Find the positions of the commas on one line, i.e., the boundaries of the fields
+ * Stops at the end of the line ('\n'), at the end of the buffer or after max_commas commas were found
+ * @param line Start of the line
+ * @param end End of the buffer
+ * @param commas Positions of the commas (output, at least max_commas elements)
+ * @param max_commas Maximum number of commas to find
+ * @return Number of commas found
+ */
+size_t find_commas(const char *line, const char *end, const char **commas, size_t max_commas);
@@ -1,6 +1,23 @@
 #include "dataloader/dataloader.h"
 
-void load_data(const std::string &filepath, patient_data &data) {
+#include <mutex>
+#include <condition_variable>
+
+#include "utils/bounded_queue.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void load_data(const std::string &filepath, patient_data &data, bool with_time) {
     /* Open the file */
     std::ifstream in_fp(filepath);
     if (!in_fp) {
@@ -12,6 +29,7 @@ void load_data(const std::string &filepath, patient_data &data) {
     data.x.clear();
     data.y.clear();
     data.z.clear();
+    data.t.clear();
 
     /* Skip header */
     std::string line;
@@ -33,13 +51,18 @@ void load_data(const std::string &filepath, patient_data &data) {
         data.x.push_back(x);
         data.y.push_back(y);
         data.z.push_back(z);
+        if (with_time) {
+            int64_t t;
+            parse_datetime(datetime.data(), datetime.data() + datetime.size(), t);
+            data.t.push_back(t);
+        }
     }
 
     /* Close the file */
     in_fp.close();
 }
 
-void load_data_fast(const std::string& filepath, patient_data &data) {
+void load_data_fast(const std::string& filepath, patient_data &data, bool with_time) {
     /* Open the file */
     FILE *in_fp = fopen(filepath.c_str(), "r");
     if (!in_fp) {
@@ -51,6 +74,7 @@ void load_data_fast(const std::string& filepath, patient_data &data) {
     data.x.clear();
     data.y.clear();
     data.z.clear();
+    data.t.clear();
 
     /* Skip header */
     char header[max_byte_value];
@@ -59,17 +83,26 @@ void load_data_fast(const std::string& filepath, patient_data &data) {
     /* Read the data */
     char datetime[max_byte_value];
     decimal x, y, z;
+    int64_t t;
     #ifndef _USE_FLOAT
     while(fscanf(in_fp, "%[^,],%lf,%lf,%lf\n", datetime, &x, &y, &z) != EOF) {
         data.x.push_back(x);
         data.y.push_back(y);
         data.z.push_back(z);
+        if (with_time) {
+            parse_datetime(datetime, datetime + strlen(datetime), t);
+            data.t.push_back(t);
+        }
     }
     #else
     while(fscanf(in_fp, "%[^,],%f,%f,%f\n", datetime, &x, &y, &z) != EOF) {
         data.x.push_back(x);
         data.y.push_back(y);
         data.z.push_back(z);
+        if (with_time) {
+            parse_datetime(datetime, datetime + strlen(datetime), t);
+            data.t.push_back(t);
+        }
     }
     #endif
 
@@ -77,7 +110,7 @@ void load_data_fast(const std::string& filepath, patient_data &data) {
     fclose(in_fp);
 }
 
-void load_data_super_fast(const std::string& filepath, patient_data &data) {
+void load_data_super_fast(const std::string& filepath, patient_data &data, bool with_time) {
     /* Open the file */
     FILE *in_fp = fopen(filepath.c_str(), "r");
     if (!in_fp) {
@@ -89,11 +122,14 @@ void load_data_super_fast(const std::string& filepath, patient_data &data) {
     data.x.clear();
     data.y.clear();
     data.z.clear();
+    data.t.clear();
 
     /* Start with 1 MB as expected size -- will be changed later in the parsing loop */
     data.x.resize(MB);
     data.y.resize(MB);
     data.z.resize(MB);
+    if (with_time)
+        data.t.resize(MB);
 
     /* Set a large buffer size */
     setvbuf(in_fp, nullptr, _IOFBF, MB);
@@ -106,32 +142,26 @@ void load_data_super_fast(const std::string& filepath, patient_data &data) {
 
     /* Read the data in large chunks */
     decimal x, y, z;
+    int64_t t = 0;
     while (fgets(buffer, sizeof(buffer), in_fp)) {
-        char *line_ptr = buffer;
+        const char *line_ptr = buffer;
 
         /* Find the end of the datetime and move to the numeric data */
         while (*line_ptr && *line_ptr != ',')
             line_ptr++;
+        if (with_time)
+            parse_datetime(buffer, line_ptr, t);
         line_ptr++; /* Skip comma */
 
-        /* Parse x, y, z values directly */
-        #ifndef _USE_FLOAT
-        x = std::strtod(line_ptr, &line_ptr);
-        line_ptr++; /* Skip comma */
-
-        y = std::strtod(line_ptr, &line_ptr);
-        line_ptr++; /* Skip comma */
-
-        z = std::strtod(line_ptr, &line_ptr);
-        #else
-        x = std::strtof(line_ptr, &line_ptr);
+        /* Parse x, y, z values directly (locale-free parser, no strtod) */
+        const char *line_end = buffer + sizeof(buffer);
+        line_ptr = parse_decimal(line_ptr, line_end, x);
         line_ptr++; /* Skip comma */
 
-        y = std::strtof(line_ptr, &line_ptr);
+        line_ptr = parse_decimal(line_ptr, line_end, y);
         line_ptr++; /* Skip comma */
 
-        z = std::strtof(line_ptr, &line_ptr);
-        #endif
+        parse_decimal(line_ptr, line_end, z);
 
         /* Ensure we have enough space */
         if (index >= data.x.size()) {
@@ -140,12 +170,16 @@ void load_data_super_fast(const std::string& filepath, patient_data &data) {
             data.x.resize(new_size);
             data.y.resize(new_size);
             data.z.resize(new_size);
+            if (with_time)
+                data.t.resize(new_size);
         }
 
         /* Store values */
         data.x[index] = x;
         data.y[index] = y;
         data.z[index] = z;
+        if (with_time)
+            data.t[index] = t;
         index++;
     }
 
@@ -153,7 +187,256 @@ void load_data_super_fast(const std::string& filepath, patient_data &data) {
     data.x.resize(index);
     data.y.resize(index);
     data.z.resize(index);
+    if (with_time)
+        data.t.resize(index);
+
+    /* Clean up */
+    fclose(in_fp);
+}
+
+/**
+ * Block of whole lines handed over from the reader to the parsers by the streaming loader
+ */
+struct stream_block {
+    /** Raw bytes of the block */
+    std::vector<char> buffer;
+    /** Number of valid bytes in the buffer */
+    size_t size = 0;
+    /** Row of the first line of the block */
+    size_t first_row = 0;
+};
+
+void load_data_stream(const std::string &filepath, patient_data &data, size_t num_parsers, size_t block_size, bool with_time) {
+    /* Open the file (in binary mode!) */
+    FILE *in_fp = fopen(filepath.c_str(), "rb");
+    if (!in_fp) {
+        std::cerr << "Error opening file: " << filepath << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    /* Get the file size -- used only to estimate the number of rows */
+    fseek(in_fp, 0, SEEK_END);
+    const size_t file_size = ftell(in_fp);
+    fseek(in_fp, 0, SEEK_SET);
+
+    /* Clean the data */
+    data.x.clear();
+    data.y.clear();
+    data.z.clear();
+    data.t.clear();
+
+    /* Pool of blocks -- the only buffers of the loader, recycled between the reader and the parsers */
+    num_parsers = std::max<size_t>(num_parsers, 1);
+    const size_t pool_size = num_parsers + 2;
+    std::vector<stream_block> pool(pool_size);
+    bounded_queue<stream_block *> free_blocks(pool_size);
+    bounded_queue<stream_block *> full_blocks(pool_size);
+    for (auto &block : pool) {
+        block.buffer.resize(block_size);
+        free_blocks.push(&block);
+    }
+
+    /* Number of blocks handed over to the parsers and not parsed yet -- the columns can be resized only when it is zero */
+    size_t in_flight = 0;
+    std::mutex in_flight_mutex;
+    std::condition_variable in_flight_done;
+
+    /* Parsers -- take a block, parse its lines into the columns, give the block back */
+    std::vector<std::thread> parsers;
+    for (size_t i = 0; i < num_parsers; i++)
+        parsers.emplace_back([&]() {
+            stream_block *block = nullptr;
+            while (full_blocks.pop(block)) {
+                const char *end = block->buffer.data() + block->size;
+                size_t row = block->first_row;
+                for (const char *line_ptr = block->buffer.data(); line_ptr < end; line_ptr = next_line(line_ptr, end))
+                    parse_line(line_ptr, end, data, row++, with_time);
+
+                free_blocks.push(block);
+                {
+                    std::lock_guard<std::mutex> lock(in_flight_mutex);
+                    in_flight--;
+                }
+                in_flight_done.notify_all();
+            }
+        });
+
+    /* Reader (this thread) */
+    std::vector<char> carry;  /* Incomplete last line of the previous block */
+    size_t num_rows = 0;
+    bool header = true;
+    bool eof = false;
+    while (!eof) {
+        stream_block *block = nullptr;
+        free_blocks.pop(block);
+
+        /* Carried over line first, then as much of the file as fits */
+        std::copy(carry.begin(), carry.end(), block->buffer.begin());
+        block->size = carry.size() + fread(block->buffer.data() + carry.size(), 1, block_size - carry.size(), in_fp);
+        eof = block->size < block_size;
+        carry.clear();
+
+        char *begin = block->buffer.data();
+        char *end = begin + block->size;
+
+        /* Skip the header (the first line of the first block) */
+        if (header) {
+            const char *first_line = next_line(begin, end);
+            std::copy(first_line, static_cast<const char *>(end), begin);
+            end -= first_line - begin;
+            block->size = end - begin;
+            header = false;
+        }
+
+        /* Only whole lines stay in the block, the rest is carried over (at the end of the file, everything stays) */
+        if (!eof) {
+            char *last_newline = end;
+            while (last_newline > begin && *(last_newline - 1) != '\n')
+                last_newline--;
+            if (last_newline == begin) {
+                std::cerr << "Line longer than the block size in file: " << filepath << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            carry.assign(last_newline, end);
+            end = last_newline;
+            block->size = end - begin;
+        }
+
+        /* Count the lines of the block -- now the reader knows which rows belong to it */
+        size_t block_rows = count_char(begin, end, '\n');
+        if (eof && end != begin && *(end - 1) != '\n')
+            block_rows++;
+        if (!block_rows) {
+            free_blocks.push(block);
+            continue;
+        }
+
+        /* Make sure the columns are large enough; the first block gives an estimate of the number of rows */
+        if (num_rows + block_rows > data.x.size()) {
+            /* Wait until nobody writes into the columns, then resize them */
+            std::unique_lock<std::mutex> lock(in_flight_mutex);
+            in_flight_done.wait(lock, [&]() { return in_flight == 0; });
+
+            const auto bytes_per_row = static_cast<double>(block->size) / static_cast<double>(block_rows);
+            const auto estimate = static_cast<size_t>(1.05 * static_cast<double>(file_size) / bytes_per_row) + 1;
+            const size_t new_size = std::max({num_rows + block_rows, estimate, data.x.size() + data.x.size() / 2});
+            data.x.resize(new_size);
+            data.y.resize(new_size);
+            data.z.resize(new_size);
+            if (with_time)
+                data.t.resize(new_size);
+        }
+
+        /* Hand the block over to the parsers */
+        block->first_row = num_rows;
+        num_rows += block_rows;
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex);
+            in_flight++;
+        }
+        full_blocks.push(block);
+    }
+
+    /* Let the parsers finish */
+    full_blocks.close();
+    for (auto &parser : parsers)
+        parser.join();
+
+    /* Resize vectors to the actual number of elements */
+    data.x.resize(num_rows);
+    data.y.resize(num_rows);
+    data.z.resize(num_rows);
+    if (with_time)
+        data.t.resize(num_rows);
 
     /* Clean up */
     fclose(in_fp);
 }
+
+bool try_map_file(const std::string &filepath, mapped_file &file) {
+    #ifdef _WIN32
+    /* Open the file */
+    HANDLE handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    /* Get the file size */
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(handle, &file_size);
+    file.size = static_cast<size_t>(file_size.QuadPart);
+
+    /* Empty file -- an empty mapping (nothing to map, unmap_file skips it) */
+    if (!file.size) {
+        CloseHandle(handle);
+        file.data = nullptr;
+        return true;
+    }
+
+    /* Map the file -- the mapping handle keeps the file alive, so the file handle can be closed right away */
+    file.mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (!file.mapping)
+        return false;
+    file.data = static_cast<const char *>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!file.data) {
+        CloseHandle(file.mapping);
+        file.mapping = nullptr;
+        return false;
+    }
+    #else
+    /* Open the file */
+    const int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    /* Get the file size */
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    file.size = static_cast<size_t>(st.st_size);
+
+    /* Empty file -- an empty mapping (mmap does not take a zero length, unmap_file skips it) */
+    if (!file.size) {
+        close(fd);
+        file.data = nullptr;
+        return true;
+    }
+
+    /* Map the file -- the mapping keeps the file alive, so the descriptor can be closed right away */
+    void *mapping = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    /* The file is read front to back -- let the kernel read ahead aggressively */
+    madvise(mapping, file.size, MADV_SEQUENTIAL);
+    file.data = static_cast<const char *>(mapping);
+    #endif
+
+    return true;
+}
+
+void map_file(const std::string &filepath, mapped_file &file) {
+    if (!try_map_file(filepath, file)) {
+        std::cerr << "Error opening or mapping file: " << filepath << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void unmap_file(mapped_file &file) {
+    if (!file.data)
+        return;
+
+    #ifdef _WIN32
+    UnmapViewOfFile(file.data);
+    CloseHandle(file.mapping);
+    file.mapping = nullptr;
+    #else
+    munmap(const_cast<char *>(file.data), file.size);
+    #endif
+
+    file.data = nullptr;
+    file.size = 0;
+}
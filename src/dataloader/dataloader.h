@@ -6,9 +6,15 @@
 #include <string>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <thread>
 
 #include <execution>
 
+#include "dataloader/csv_scanner.h"
+#include "dataloader/number_parser.h"
+#include "dataloader/datetime_parser.h"
 #include "utils/utils.h"
 
 /* Disabling C4996 warning, because I know what I am doing with the old C functions like fopen, strtok, etc. */
@@ -20,53 +26,133 @@ constexpr size_t max_byte_value = 256;
 constexpr size_t KB = 1 << 10;
 /** 1 MB */
 constexpr size_t MB = KB << 10;
+/** Size of one block read by the streaming loader */
+constexpr size_t stream_block_size = MB;
 
 /**
  * Data structure to store the loaded data
- * Contains three vectors for X, Y and Z data
+ * Contains three vectors for X, Y and Z data (and optionally the timestamps of the rows)
  */
 struct patient_data {
     /** X data */
-    std::vector<decimal> x;
+    decimal_vector x;
     /** Y data */
-    std::vector<decimal> y;
+    decimal_vector y;
     /** Z data */
-    std::vector<decimal> z;
+    decimal_vector z;
+    /** Timestamps in microseconds since the epoch (datetime column) -- empty, unless the loader was asked for them */
+    std::vector<int64_t> t;
+};
+
+/**
+ * Read-only memory mapping of a whole file
+ * Created by map_file and released by unmap_file
+ */
+struct mapped_file {
+    /** Pointer to the first byte of the file */
+    const char *data = nullptr;
+    /** Size of the file in bytes */
+    size_t size = 0;
+    #ifdef _WIN32
+    /** File mapping handle (Windows only) */
+    void *mapping = nullptr;
+    #endif
 };
 
 /**
  * Load data from a file using the standard C++ I/O functions (std::ifstream, std::getline)
  * @param filepath Path to the file
  * @param data Data structure to store the loaded data
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
  */
-void load_data(const std::string &filepath, patient_data &data);
+void load_data(const std::string &filepath, patient_data &data, bool with_time = false);
 
 /**
  * Load data from a file using the standard ANSI C I/O functions (fopen, fscanf, fclose)
  * @param filepath Path to the file
  * @param data Data structure to store the loaded data
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
  */
-void load_data_fast(const std::string &filepath, patient_data &data);
+void load_data_fast(const std::string &filepath, patient_data &data, bool with_time = false);
 
 /**
  * Loads data from a file super fast using the standard ANSI C I/O functions (fopen, fscanf, fclose)
  * Uses a large buffer and resizing of vectors and direct indexing
  * @param filepath Path to the file
  * @param data Data structure to store the loaded data
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
+ */
+void load_data_super_fast(const std::string &filepath, patient_data &data, bool with_time = false);
+
+/**
+ * Find the start of the line that follows the given position (or end, if there is no other line)
+ * @param ptr Position somewhere inside of a line
+ * @param end End of the buffer
+ * @return Pointer to the first byte after the next newline
+ */
+inline const char *next_line(const char *ptr, const char *end) {
+    const char *newline = find_char(ptr, end, '\n');
+    return newline < end ? newline + 1 : end;
+}
+
+/**
+ * Split the buffer into byte ranges of roughly the same size, each one starting at the start of a line
+ * @param begin Start of the buffer (start of a line)
+ * @param end End of the buffer
+ * @param num_chunks Number of ranges
+ * @return num_chunks + 1 boundaries -- range i is [boundaries[i], boundaries[i + 1])
  */
-void load_data_super_fast(const std::string &filepath, patient_data &data);
+inline std::vector<const char *> split_lines(const char *begin, const char *end, size_t num_chunks) {
+    const size_t chunk_size = (end - begin) / num_chunks;
+    std::vector<const char *> boundaries(num_chunks + 1);
+    boundaries[0] = begin;
+    boundaries[num_chunks] = end;
+    for (size_t i = 1; i < num_chunks; i++)
+        boundaries[i] = chunk_size ? next_line(begin + i * chunk_size - 1, end) : begin;
+    return boundaries;
+}
+
+/**
+ * Parse one line (datetime,x,y,z) straight out of the buffer -- no copy of the line is made
+ * The field boundaries are found by the structural scanner, the datetime column is skipped unless with_time is set
+ * @param line_ptr Start of the line
+ * @param end End of the buffer
+ * @param data Data structure to store the parsed values into
+ * @param index Index (row) where to store the parsed values
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t has to be resized already)
+ */
+inline void parse_line(const char *line_ptr, const char *end, patient_data &data, size_t index, bool with_time = false) {
+    /* Find the three commas separating datetime, x, y and z */
+    const char *commas[3];
+    if (find_commas(line_ptr, end, commas, 3) < 3) {
+        data.x[index] = data.y[index] = data.z[index] = 0;  /* Malformed line */
+        if (with_time)
+            data.t[index] = 0;
+        return;
+    }
+
+    /* Datetime is the first field (fixed format, parsed in place) */
+    if (with_time)
+        parse_datetime(line_ptr, commas[0], data.t[index]);
+
+    /* Parse x, y, z values directly -- each field starts right after its comma (locale-free parser, no strtod) */
+    parse_decimal(commas[0] + 1, end, data.x[index]);
+    parse_decimal(commas[1] + 1, end, data.y[index]);
+    parse_decimal(commas[2] + 1, end, data.z[index]);
+}
 
 /**
- * Loads data from a file in parallel using the standard ANSI C I/O functions (fopen, fscanf, fclose)
- * Also uses ANSI C string functions (strtok, strcpy) and atof, because for some reason strtod is slow in parallel
+ * Loads data from a file in parallel using the standard ANSI C I/O functions (fopen, fread, fclose)
+ * The lines are indexed by the SIMD structural scanner and parsed in place (no copy of the lines) by the fast number parser
  * This function has to be implemented in here (.h), because of the template
  * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
  * @param policy Execution policy
  * @param filepath Path to the file
  * @param data Data structure to store the loaded data
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
  */
 template <typename exec_policy>
-void load_data_parallel(exec_policy policy, const std::string &filepath, patient_data &data) {
+void load_data_parallel(exec_policy policy, const std::string &filepath, patient_data &data, bool with_time = false) {
     /* Open the file (in binary mode!) */
     FILE *in_fp = fopen(filepath.c_str(), "rb");
     if (!in_fp) {
@@ -84,29 +170,23 @@ void load_data_parallel(exec_policy policy, const std::string &filepath, patient
     fread(buffer, 1, file_size, in_fp);
     fclose(in_fp);
 
-    /* Parse per lines */
-    std::vector<std::string_view> lines;
-    size_t start_index = 0;  /* Start of the line */
-    for (size_t i = 0; i < file_size; i++) {
-        if (buffer[i] == '\n') {
-            lines.emplace_back(buffer + start_index, i - start_index);
-            start_index = i + 1;  /* Skip the newline */
-        }
-    }
-
-    /* Skip the header */
-    lines.erase(lines.begin());
+    /* Structural index of the lines -- positions of all newlines, found 32 bytes at a time */
+    std::vector<size_t> newlines;
+    index_char(buffer, buffer + file_size, '\n', newlines);
 
     /* Clean the data */
     data.x.clear();
     data.y.clear();
     data.z.clear();
+    data.t.clear();
 
-    /* Resize the vectors to the number of lines -- big advantage here over the previous load */
-    size_t num_lines = lines.size();
+    /* Resize the vectors to the number of lines (header is skipped) -- big advantage here over the previous load */
+    size_t num_lines = newlines.empty() ? 0 : newlines.size() - 1;
     data.x.resize(num_lines);
     data.y.resize(num_lines);
     data.z.resize(num_lines);
+    if (with_time)
+        data.t.resize(num_lines);
 
     /* Prepare for parallelism */
     const auto max_num_threads = std::thread::hardware_concurrency();
@@ -119,39 +199,129 @@ void load_data_parallel(exec_policy policy, const std::string &filepath, patient
         /* Final thread may have to handle a little more elements */
         const size_t end = (i == max_num_threads - 1) ? num_lines : (i + 1) * chunk_size;
 
-        char line[max_byte_value];
-        /* Parse the lines */
-        for (size_t j = start; j < end; j++) {
-            /* Copy the line to a buffer */
-            strncpy(line, lines[j].data(), lines[j].size());
-            char *line_ptr = line;
+        /* Parse the lines -- line j starts right after the newline j (newline 0 ends the header) */
+        for (size_t j = start; j < end; j++)
+            parse_line(buffer + newlines[j] + 1, buffer + file_size, data, j, with_time);
+    });
+
+    /* Clean up */
+    delete[] buffer;
+}
+
+/**
+ * Loads data from a file as a stream of fixed-size blocks with bounded memory
+ * A reader thread reads the blocks (only whole lines, the incomplete last line is carried over to the next block),
+ * counts their lines to know where they belong and hands them over to the parser threads through a bounded queue
+ * The parsers fill the columns while the following blocks are still being read; the blocks are recycled in a pool,
+ * so the peak memory is the output columns plus (num_parsers + 2) blocks, regardless of the file size
+ * @param filepath Path to the file
+ * @param data Data structure to store the loaded data
+ * @param num_parsers Number of parser threads
+ * @param block_size Size of one block in bytes (has to be larger than the longest line)
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
+ */
+void load_data_stream(const std::string &filepath, patient_data &data, size_t num_parsers = std::thread::hardware_concurrency(), size_t block_size = stream_block_size, bool with_time = false);
+
+/**
+ * Map the whole file into memory (read only) and hint the kernel about sequential access (madvise)
+ * An empty file gives an empty mapping (data = nullptr, size = 0)
+ * @param filepath Path to the file
+ * @param file Mapped file (output)
+ * @return False if the file cannot be opened or mapped (nothing to unmap then)
+ */
+bool try_map_file(const std::string &filepath, mapped_file &file);
+
+/**
+ * Map the whole file into memory (read only), see try_map_file
+ * Exits the program if the file cannot be opened or mapped
+ * @param filepath Path to the file
+ * @param file Mapped file (output)
+ */
+void map_file(const std::string &filepath, mapped_file &file);
+
+/**
+ * Release the memory mapping created by map_file
+ * @param file Mapped file
+ */
+void unmap_file(mapped_file &file);
+
+/**
+ * Loads data from a memory mapped file in parallel (zero-copy)
+ * The file is never read into a separate buffer, there is no line index and no per-line copy:
+ * the mapping is split into one byte range per thread (aligned to line starts), the lines are counted (first pass)
+ * and then parsed directly out of the mapping into the preallocated vectors (second pass)
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param filepath Path to the file
+ * @param data Data structure to store the loaded data
+ * @param with_time Whether the datetime column should be parsed into the timestamps (data.t)
+ */
+template <typename exec_policy>
+void load_data_mmap(exec_policy policy, const std::string &filepath, patient_data &data, bool with_time = false) {
+    /* Map the file into memory */
+    mapped_file file;
+    map_file(filepath, file);
+
+    /* Empty file -- no header, no rows (empty columns) */
+    if (!file.size) {
+        data.x.clear();
+        data.y.clear();
+        data.z.clear();
+        data.t.clear();
+        return;
+    }
+
+    /* Skip the header */
+    const char *end = file.data + file.size;
+    const char *begin = next_line(file.data, end);
+
+    /* Split the mapping into byte ranges, each one starting at the start of a line */
+    const auto max_num_threads = std::thread::hardware_concurrency();
+    const auto chunk_starts = split_lines(begin, end, max_num_threads);
 
-            /* Find the end of the datetime and move to the numeric data */
-            while (*line_ptr && *line_ptr != ',')
-                line_ptr++;
-            line_ptr++; /* Skip comma */
+    /* First pass -- count the lines in each chunk (the last line does not have to end with a newline) */
+    std::vector<size_t> chunk_rows(max_num_threads + 1, 0);
+    std::vector<size_t> chunk_indices(max_num_threads);
+    std::iota(chunk_indices.begin(), chunk_indices.end(), 0);
+
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const char *start = chunk_starts[i];
+        const char *stop = chunk_starts[i + 1];
+        chunk_rows[i + 1] = count_char(start, stop, '\n');
+        if (stop == end && start != stop && *(stop - 1) != '\n')
+            chunk_rows[i + 1]++;
+    });
 
-            /* Parse x, y, z values directly */
-            #ifndef _USE_FLOAT
-            data.x[j] = std::strtod(line_ptr, &line_ptr);
-            line_ptr++; /* Skip comma */
+    /* Prefix sum -- chunk_rows[i] is now the first row of chunk i */
+    std::partial_sum(chunk_rows.begin(), chunk_rows.end(), chunk_rows.begin());
+    const size_t num_lines = chunk_rows[max_num_threads];
 
-            data.y[j] = std::strtod(line_ptr, &line_ptr);
-            line_ptr++; /* Skip comma */
+    /* Clean the data and resize the vectors to the number of lines */
+    data.x.clear();
+    data.y.clear();
+    data.z.clear();
+    data.t.clear();
+    data.x.resize(num_lines);
+    data.y.resize(num_lines);
+    data.z.resize(num_lines);
+    if (with_time)
+        data.t.resize(num_lines);
 
-            data.z[j] = std::strtod(line_ptr, &line_ptr);
-            #else
-            data.x[j] = std::strtof(line_ptr, &line_ptr);
-            line_ptr++; /* Skip comma */
+    /* Second pass -- parse the lines straight out of the mapping */
+    std::for_each(policy, chunk_indices.begin(), chunk_indices.end(), [&](const auto i) {
+        const char *line_ptr = chunk_starts[i];
+        const char *stop = chunk_starts[i + 1];
+        size_t row = chunk_rows[i];
 
-            data.y[j] = std::strtof(line_ptr, &line_ptr);
-            line_ptr++; /* Skip comma */
+        while (line_ptr < stop) {
+            const char *next = next_line(line_ptr, end);
 
-            data.z[j] = std::strtof(line_ptr, &line_ptr);
-            #endif
+            parse_line(line_ptr, end, data, row++, with_time);
+            line_ptr = next;
         }
     });
 
     /* Clean up */
-    delete[] buffer;
+    unmap_file(file);
 }
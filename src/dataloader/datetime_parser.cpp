@@ -0,0 +1,70 @@
+#include "dataloader/datetime_parser.h"
+
+/** Length of the fixed part "YYYY-MM-DD HH:MM:SS" */
+constexpr size_t datetime_length = 19;
+/** Number of fraction digits kept (microseconds) */
+constexpr size_t fraction_digits = 6;
+
+/**
+ * Value of the decimal digit (or a value > 9 if the character is not a digit)
+ * @param c Character
+ * @return Value of the digit
+ */
+static uint32_t digit(char c) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(c) - '0');
+}
+
+/**
+ * Parse the fixed number of digits
+ * @param ptr Start of the digits
+ * @param count Number of digits
+ * @param value Parsed number (output)
+ * @return True if all the characters were digits
+ */
+static bool parse_digits(const char *ptr, size_t count, int64_t &value) {
+    uint32_t result = 0;
+    uint32_t invalid = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t d = digit(ptr[i]);
+        invalid |= d > 9;
+        result = result * 10 + d;
+    }
+    value = result;
+    return !invalid;
+}
+
+const char *parse_datetime(const char *first, const char *last, int64_t &value) {
+    value = 0;
+    if (last - first < static_cast<ptrdiff_t>(datetime_length))
+        return first;
+
+    /* Separators at their fixed positions */
+    const char *p = first;
+    if (p[4] != '-' || p[7] != '-' || (p[10] != ' ' && p[10] != 'T') || p[13] != ':' || p[16] != ':')
+        return first;
+
+    /* Fields at their fixed positions (validity of all of them is checked at once) */
+    int64_t year, month, day, hour, minute, second;
+    const bool digits = parse_digits(p, 4, year) & parse_digits(p + 5, 2, month) & parse_digits(p + 8, 2, day)
+                        & parse_digits(p + 11, 2, hour) & parse_digits(p + 14, 2, minute) & parse_digits(p + 17, 2, second);
+    if (!digits || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return first;
+
+    int64_t seconds = days_from_civil(year, month, day) * seconds_per_day + hour * 3600 + minute * 60 + second;
+    p += datetime_length;
+
+    /* Optional fraction -- padded (or truncated) to microseconds */
+    int64_t fraction = 0;
+    if (p < last && *p == '.') {
+        p++;
+        size_t count = 0;
+        for (; p < last && digit(*p) <= 9; p++, count++)
+            if (count < fraction_digits)
+                fraction = fraction * 10 + digit(*p);
+        for (; count < fraction_digits; count++)
+            fraction *= 10;
+    }
+
+    value = seconds * microseconds_per_second + fraction;
+    return p;
+}
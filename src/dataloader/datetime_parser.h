@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Fixed-format parser of the datetime column ("YYYY-MM-DD HH:MM:SS" with an optional fraction ".ffffff")
+ * All the fields are at known offsets, so there is no scanning, no sscanf / strptime and no locale --
+ * the digits are read straight from their positions and the date is turned into days by days_from_civil
+ * The timestamps are microseconds since 1970-01-01 00:00:00 (the datetime is taken as UTC, no time zones)
+ */
+
+/** Microseconds in one second */
+constexpr int64_t microseconds_per_second = 1000000;
+/** Seconds in one day */
+constexpr int64_t seconds_per_day = 86400;
+
+/**
+ * Number of days since 1970-01-01 of the given date in the proleptic Gregorian calendar
+ * (H. Hinnant's days_from_civil algorithm -- no tables, no loops)
+ * @param year Year
+ * @param month Month (1 - 12)
+ * @param day Day (1 - 31)
+ * @return Number of days since 1970-01-01 (negative before)
+ */
+constexpr int64_t days_from_civil(int64_t year, int64_t month, int64_t day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+/**
+ * Parse a datetime "YYYY-MM-DD HH:MM:SS[.f...]" from [first, last) into microseconds since the epoch
+ * The date and the time may also be separated by 'T'; fraction digits past the sixth one are truncated
+ * @param first Start of the datetime
+ * @param last End of the buffer (the parser never reads past it)
+ * @param value Parsed timestamp (output, set to 0 if nothing could be parsed)
+ * @return Pointer right after the parsed datetime (first, if it is not a valid datetime)
+ */
+const char *parse_datetime(const char *first, const char *last, int64_t &value);
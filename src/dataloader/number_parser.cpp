@@ -0,0 +1,496 @@
+#include "dataloader/number_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+/* Disabling C4996 warning, because I know what I am doing with the old C functions like strtod, etc. */
+#pragma warning(disable : 4996)
+#endif
+
+/** Smallest power of five (ten) with an entry in the 128-bit table */
+constexpr int smallest_power_of_five = -342;
+/** Largest power of five (ten) with an entry in the 128-bit table */
+constexpr int largest_power_of_five = 308;
+/** Maximum number of significant digits that fit into the 64-bit mantissa */
+constexpr int64_t max_digits = 19;
+/** Maximum length of a number handed over to the strtod fallback */
+constexpr size_t max_fallback_length = 128;
+
+/**
+ * 128-bit unsigned value (two 64-bit halves)
+ */
+struct value128 {
+    /** Low 64 bits */
+    uint64_t low;
+    /** High 64 bits */
+    uint64_t high;
+};
+
+/**
+ * Properties of the IEEE-754 binary format (double / float) needed by the parser
+ * Constants are taken from the Eisel-Lemire paper (Lemire, Number Parsing at a Gigabyte per Second, 2021)
+ * @tparam T Floating point type
+ */
+template <typename T>
+struct binary_format;
+
+/**
+ * Properties of the IEEE-754 binary64 format (double)
+ */
+template <>
+struct binary_format<double> {
+    /** Unsigned integer with the same size */
+    using bits_type = uint64_t;
+    /** Number of explicitly stored mantissa bits */
+    static constexpr int mantissa_explicit_bits = 52;
+    /** Exponent bias (negative) */
+    static constexpr int minimum_exponent = -1023;
+    /** Biased exponent of infinity */
+    static constexpr int infinite_power = 0x7FF;
+    /** Range of q where the round-to-even ambiguity can occur */
+    static constexpr int min_exponent_round_to_even = -4;
+    /** Range of q where the round-to-even ambiguity can occur */
+    static constexpr int max_exponent_round_to_even = 23;
+    /** Largest |q| for Clinger's fast path */
+    static constexpr int max_exponent_fast_path = 22;
+    /** Largest mantissa for Clinger's fast path (exactly representable) */
+    static constexpr uint64_t max_mantissa_fast_path = uint64_t(1) << 53;
+
+    /**
+     * Exactly representable power of ten
+     * @param e Exponent (0 <= e <= max_exponent_fast_path)
+     * @return 10^e
+     */
+    static double exact_power_of_ten(int64_t e) {
+        static constexpr double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        return powers[e];
+    }
+
+    /**
+     * Fallback parser
+     * @param str Null terminated string
+     * @param end End of the parsed number (output)
+     * @return Parsed value
+     */
+    static double fallback(const char *str, char **end) {
+        return std::strtod(str, end);
+    }
+};
+
+/**
+ * Properties of the IEEE-754 binary32 format (float)
+ */
+template <>
+struct binary_format<float> {
+    /** Unsigned integer with the same size */
+    using bits_type = uint32_t;
+    /** Number of explicitly stored mantissa bits */
+    static constexpr int mantissa_explicit_bits = 23;
+    /** Exponent bias (negative) */
+    static constexpr int minimum_exponent = -127;
+    /** Biased exponent of infinity */
+    static constexpr int infinite_power = 0xFF;
+    /** Range of q where the round-to-even ambiguity can occur */
+    static constexpr int min_exponent_round_to_even = -17;
+    /** Range of q where the round-to-even ambiguity can occur */
+    static constexpr int max_exponent_round_to_even = 10;
+    /** Largest |q| for Clinger's fast path */
+    static constexpr int max_exponent_fast_path = 10;
+    /** Largest mantissa for Clinger's fast path (exactly representable) */
+    static constexpr uint64_t max_mantissa_fast_path = uint64_t(1) << 24;
+
+    /**
+     * Exactly representable power of ten
+     * @param e Exponent (0 <= e <= max_exponent_fast_path)
+     * @return 10^e
+     */
+    static float exact_power_of_ten(int64_t e) {
+        static constexpr float powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+        return powers[e];
+    }
+
+    /**
+     * Fallback parser
+     * @param str Null terminated string
+     * @param end End of the parsed number (output)
+     * @return Parsed value
+     */
+    static float fallback(const char *str, char **end) {
+        return std::strtof(str, end);
+    }
+};
+
+/**
+ * Full 64x64 -> 128-bit multiplication
+ * @param a First operand
+ * @param b Second operand
+ * @return 128-bit product
+ */
+static value128 full_multiplication(uint64_t a, uint64_t b) {
+    value128 result{};
+    #if defined(_MSC_VER) && defined(_M_X64)
+    result.low = _umul128(a, b, &result.high);
+    #elif defined(__SIZEOF_INT128__)
+    __extension__ using uint128_t = unsigned __int128;
+    const uint128_t product = static_cast<uint128_t>(a) * b;
+    result.low = static_cast<uint64_t>(product);
+    result.high = static_cast<uint64_t>(product >> 64);
+    #else
+    /* Portable schoolbook multiplication of the 32-bit halves */
+    const uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32, b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    result.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    result.low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    #endif
+    return result;
+}
+
+/**
+ * Number of leading zero bits (value must not be zero)
+ * @param value Value
+ * @return Number of leading zero bits
+ */
+static int leading_zeros64(uint64_t value) {
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - static_cast<int>(index);
+    #else
+    return __builtin_clzll(value);
+    #endif
+}
+
+/* Minimal arbitrary precision arithmetic (little endian 32-bit limbs) used only to build the table of powers */
+
+/**
+ * Multiply the big number by a small factor
+ * @param num Big number
+ * @param factor Factor
+ */
+static void big_multiply(std::vector<uint32_t> &num, uint32_t factor) {
+    uint64_t carry = 0;
+    for (auto &limb : num) {
+        const uint64_t product = static_cast<uint64_t>(limb) * factor + carry;
+        limb = static_cast<uint32_t>(product);
+        carry = product >> 32;
+    }
+    if (carry)
+        num.push_back(static_cast<uint32_t>(carry));
+}
+
+/**
+ * Divide the big number by a small divisor (quotient is rounded down)
+ * @param num Big number
+ * @param divisor Divisor
+ */
+static void big_divide(std::vector<uint32_t> &num, uint32_t divisor) {
+    uint64_t remainder = 0;
+    for (size_t i = num.size(); i-- > 0;) {
+        const uint64_t current = (remainder << 32) | num[i];
+        num[i] = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    while (!num.empty() && !num.back())
+        num.pop_back();
+}
+
+/**
+ * Number of significant bits of the big number
+ * @param num Big number
+ * @return Bit length
+ */
+static size_t big_bit_length(const std::vector<uint32_t> &num) {
+    if (num.empty())
+        return 0;
+    return 32 * (num.size() - 1) + 64 - leading_zeros64(num.back());
+}
+
+/**
+ * Shift the big number to have exactly 128 significant bits (left shift or truncating right shift)
+ * and return it as a 128-bit value
+ * @param num Big number (not zero)
+ * @return Normalized 128-bit value
+ */
+static value128 big_normalize_128(std::vector<uint32_t> num) {
+    const size_t length = big_bit_length(num);
+    std::vector<uint32_t> shifted(4, 0);
+
+    /* Bit i of the result is bit (i + length - 128) of the number */
+    for (size_t i = 0; i < 128; i++) {
+        const auto source = static_cast<int64_t>(i + length) - 128;
+        if (source < 0)
+            continue;
+        if ((num[source / 32] >> (source % 32)) & 1)
+            shifted[i / 32] |= 1u << (i % 32);
+    }
+
+    return {(static_cast<uint64_t>(shifted[1]) << 32) | shifted[0], (static_cast<uint64_t>(shifted[3]) << 32) | shifted[2]};
+}
+
+/**
+ * Generate the table of 128-bit approximations of 5^q, q = smallest_power_of_five..largest_power_of_five
+ * Positive powers are truncated, negative powers are 2^b / 5^-q rounded up (same as in the Eisel-Lemire paper)
+ * @return Table with two entries (high, low) per power
+ */
+static std::vector<uint64_t> generate_power_of_five_table() {
+    std::vector<uint64_t> table(2 * (largest_power_of_five - smallest_power_of_five + 1));
+    const auto store = [&](int q, const value128 &value) {
+        table[2 * (q - smallest_power_of_five)] = value.high;
+        table[2 * (q - smallest_power_of_five) + 1] = value.low;
+    };
+
+    /* Negative powers -- 2^b / 5^p, p = -q; the division by 5^p is done as a chain of divisions by 5^13 (fits 32 bits) */
+    std::vector<uint32_t> power5 = {1};
+    for (int p = 1; p <= -smallest_power_of_five; p++) {
+        big_multiply(power5, 5);
+        const size_t z = big_bit_length(power5);
+        const size_t b = p <= 27 ? z + 127 : 2 * z + 128;
+
+        std::vector<uint32_t> num(b / 32 + 1, 0);
+        num.back() = 1u << (b % 32);
+        for (int remaining = p; remaining > 0; remaining -= 13) {
+            uint32_t divisor = 1;
+            for (int i = 0; i < std::min(remaining, 13); i++)
+                divisor *= 5;
+            big_divide(num, divisor);
+        }
+
+        /* Round up (+ 1), then truncate to 128 bits */
+        for (auto &limb : num)
+            if (++limb)
+                break;
+        store(-p, big_normalize_128(num));
+    }
+
+    /* Non-negative powers -- 5^q truncated to 128 bits */
+    power5 = {1};
+    for (int q = 0; q <= largest_power_of_five; q++) {
+        store(q, big_normalize_128(power5));
+        big_multiply(power5, 5);
+    }
+
+    return table;
+}
+
+/**
+ * Table of 128-bit approximations of the powers of five (generated once, on first use)
+ * @return Table with two entries (high, low) per power
+ */
+static const std::vector<uint64_t> &power_of_five_table() {
+    static const std::vector<uint64_t> table = generate_power_of_five_table();
+    return table;
+}
+
+/**
+ * Eisel-Lemire algorithm -- compute the correctly rounded value of w * 10^q
+ * @tparam T Floating point type
+ * @param w Decimal mantissa (not zero, at most 19 digits)
+ * @param q Decimal exponent (smallest_power_of_five <= q <= largest_power_of_five)
+ * @param negative Whether the number is negative
+ * @param value Result (output)
+ * @return Whether the result is valid -- false means the fallback has to be used (subnormals, overflow, ambiguity)
+ */
+template <typename T>
+static bool eisel_lemire(uint64_t w, int64_t q, bool negative, T &value) {
+    using format = binary_format<T>;
+    const auto &table = power_of_five_table();
+
+    /* Normalize the mantissa -- the most significant bit is set */
+    const int lz = leading_zeros64(w);
+    w <<= lz;
+
+    /* Multiply by the 128-bit approximation of 5^q, use the lower half only if the upper one is not precise enough */
+    constexpr uint64_t precision_mask = 0xFFFFFFFFFFFFFFFF >> (format::mantissa_explicit_bits + 3);
+    const size_t index = 2 * (q - smallest_power_of_five);
+    value128 product = full_multiplication(w, table[index]);
+    if ((product.high & precision_mask) == precision_mask) {
+        const value128 second = full_multiplication(w, table[index + 1]);
+        product.low += second.high;
+        if (second.high > product.low)
+            product.high++;
+    }
+
+    /* The truncated product might be just below a rounding boundary -- let the fallback decide */
+    if (product.low == 0xFFFFFFFFFFFFFFFF)
+        return false;
+
+    /* Extract the mantissa (with one extra bit for rounding) and the binary exponent */
+    const int upper_bit = static_cast<int>(product.high >> 63);
+    const int shift = upper_bit + 64 - format::mantissa_explicit_bits - 3;
+    uint64_t mantissa = product.high >> shift;
+    int64_t power2 = (((152170 + 65536) * q) >> 16) + 63 + upper_bit - lz - format::minimum_exponent;
+
+    /* Subnormals are left for the fallback */
+    if (power2 <= 0)
+        return false;
+
+    /* Exactly halfway between two values -- round to even */
+    if (product.low <= 1 && q >= format::min_exponent_round_to_even && q <= format::max_exponent_round_to_even &&
+        (mantissa & 3) == 1 && (mantissa << shift) == product.high)
+        mantissa &= ~uint64_t(1);
+
+    /* Round (the extra bit) */
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t(2) << format::mantissa_explicit_bits)) {
+        mantissa = uint64_t(1) << format::mantissa_explicit_bits;
+        power2++;
+    }
+    mantissa &= ~(uint64_t(1) << format::mantissa_explicit_bits);
+
+    /* Overflow is left for the fallback */
+    if (power2 >= format::infinite_power)
+        return false;
+
+    /* Assemble the IEEE-754 bits */
+    auto bits = static_cast<typename format::bits_type>(mantissa | (static_cast<uint64_t>(power2) << format::mantissa_explicit_bits));
+    if (negative)
+        bits |= static_cast<typename format::bits_type>(1) << (8 * sizeof(T) - 1);
+    memcpy(&value, &bits, sizeof(T));
+
+    return true;
+}
+
+/**
+ * Fallback -- copy the number into a null terminated buffer and use strtod / strtof
+ * @tparam T Floating point type
+ * @param first Start of the number
+ * @param last End of the buffer
+ * @param value Parsed value (output)
+ * @return Pointer right after the parsed number
+ */
+template <typename T>
+static const char *parse_fallback(const char *first, const char *last, T &value) {
+    char buffer[max_fallback_length + 1];
+    const size_t length = first < last ? std::min(static_cast<size_t>(last - first), max_fallback_length) : 0;
+    memcpy(buffer, first, length);
+    buffer[length] = '\0';
+
+    char *end;
+    value = binary_format<T>::fallback(buffer, &end);
+    return first + (end - buffer);
+}
+
+/**
+ * Check whether the character is a decimal digit (locale-free)
+ * @param c Character
+ * @return Whether c is in '0'..'9'
+ */
+static bool is_digit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+/**
+ * Parse the decimal number -- implementation shared by the double and float versions
+ * @tparam T Floating point type
+ * @param first Start of the number
+ * @param last End of the buffer
+ * @param value Parsed value (output)
+ * @return Pointer right after the parsed number
+ */
+template <typename T>
+static const char *parse_decimal_impl(const char *first, const char *last, T &value) {
+    using format = binary_format<T>;
+    const char *ptr = first;
+
+    /* Skip leading spaces (strtod does the same) */
+    while (ptr < last && (*ptr == ' ' || *ptr == '\t'))
+        ptr++;
+
+    /* Sign */
+    bool negative = false;
+    if (ptr < last && (*ptr == '-' || *ptr == '+')) {
+        negative = *ptr == '-';
+        ptr++;
+    }
+
+    /* Integer part -- digits are accumulated into w (overflow is handled by the digit count below) */
+    const char *start_digits = ptr;
+    uint64_t w = 0;
+    while (ptr < last && is_digit(*ptr))
+        w = 10 * w + (*ptr++ - '0');
+    int64_t digit_count = ptr - start_digits;
+
+    /* Fractional part -- each digit decreases the decimal exponent */
+    int64_t exponent = 0;
+    if (ptr < last && *ptr == '.') {
+        const char *start_fraction = ++ptr;
+        while (ptr < last && is_digit(*ptr))
+            w = 10 * w + (*ptr++ - '0');
+        exponent = start_fraction - ptr;
+        digit_count -= exponent;
+    }
+
+    /* No digits at all -- nan, inf or not a number, strtod knows what to do */
+    if (digit_count == 0)
+        return parse_fallback(first, last, value);
+
+    /* Exponent -- consumed only if there is at least one digit after the 'e' */
+    if (ptr < last && (*ptr == 'e' || *ptr == 'E')) {
+        const char *location_of_e = ptr++;
+        bool negative_exponent = false;
+        if (ptr < last && (*ptr == '-' || *ptr == '+')) {
+            negative_exponent = *ptr == '-';
+            ptr++;
+        }
+
+        if (ptr < last && is_digit(*ptr)) {
+            int64_t exponent_number = 0;
+            while (ptr < last && is_digit(*ptr)) {
+                if (exponent_number < 0x10000)
+                    exponent_number = 10 * exponent_number + (*ptr - '0');
+                ptr++;
+            }
+            exponent += negative_exponent ? -exponent_number : exponent_number;
+        } else {
+            ptr = location_of_e;
+        }
+    }
+
+    /* Too many digits for the 64-bit mantissa (leading zeros do not count) -- fallback */
+    if (digit_count > max_digits) {
+        for (const char *digit = start_digits; digit < last && (*digit == '0' || *digit == '.'); digit++)
+            if (*digit == '0')
+                digit_count--;
+        if (digit_count > max_digits)
+            return parse_fallback(first, last, value);
+    }
+
+    /* Zero */
+    if (w == 0) {
+        value = negative ? -static_cast<T>(0) : static_cast<T>(0);
+        return ptr;
+    }
+
+    /* Clinger's fast path -- both w and 10^|q| are exact, so one correctly rounded operation gives the exact result */
+    if (exponent >= -format::max_exponent_fast_path && exponent <= format::max_exponent_fast_path && w <= format::max_mantissa_fast_path) {
+        value = static_cast<T>(w);
+        if (exponent < 0)
+            value = value / format::exact_power_of_ten(-exponent);
+        else
+            value = value * format::exact_power_of_ten(exponent);
+        if (negative)
+            value = -value;
+        return ptr;
+    }
+
+    /* Eisel-Lemire */
+    if (exponent >= smallest_power_of_five && exponent <= largest_power_of_five && eisel_lemire(w, exponent, negative, value))
+        return ptr;
+
+    return parse_fallback(first, last, value);
+}
+
+const char *parse_decimal(const char *first, const char *last, double &value) {
+    return parse_decimal_impl(first, last, value);
+}
+
+const char *parse_decimal(const char *first, const char *last, float &value) {
+    return parse_decimal_impl(first, last, value);
+}
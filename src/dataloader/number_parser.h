@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Locale-free parser of decimal floating point numbers (replacement for std::strtod / std::strtof)
+ * The digits are accumulated into a 64-bit integer w and a decimal exponent q (value = w * 10^q), then:
+ *   1) Clinger's fast path -- if w and 10^q are both exactly representable, one multiplication / division is exact
+ *   2) Eisel-Lemire -- w is multiplied by a 128-bit approximation of 5^q and the result is rounded correctly
+ *   3) Fallback to strtod / strtof for everything else (more than 19 digits, subnormals, nan, inf, ...)
+ * The results are bit-exact with the correctly rounded strtod / strtof
+ */
+
+/**
+ * Parse a decimal number from [first, last) into a double
+ * Leading spaces and tabs are skipped, the number ends at the first character that cannot be a part of it
+ * @param first Start of the number
+ * @param last End of the buffer (the parser never reads past it)
+ * @param value Parsed value (output, set to 0 if nothing could be parsed)
+ * @return Pointer right after the parsed number (first, if nothing could be parsed)
+ */
+const char *parse_decimal(const char *first, const char *last, double &value);
+
+/**
+ * Parse a decimal number from [first, last) into a float
+ * Leading spaces and tabs are skipped, the number ends at the first character that cannot be a part of it
+ * @param first Start of the number
+ * @param last End of the buffer (the parser never reads past it)
+ * @param value Parsed value (output, set to 0 if nothing could be parsed)
+ * @return Pointer right after the parsed number (first, if nothing could be parsed)
+ */
+const char *parse_decimal(const char *first, const char *last, float &value);
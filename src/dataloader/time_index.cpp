@@ -0,0 +1,11 @@
+#include "dataloader/time_index.h"
+
+index_range time_range(const patient_data &data, int64_t from, int64_t to) {
+    if (from >= to)
+        return {};
+
+    /* Two binary searches over the ordered timestamps */
+    const auto first = std::lower_bound(data.t.begin(), data.t.end(), from);
+    const auto last = std::lower_bound(first, data.t.end(), to);
+    return {static_cast<size_t>(first - data.t.begin()), static_cast<size_t>(last - data.t.begin())};
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <execution>
+
+#include "dataloader/dataloader.h"
+
+/*
+ * Time index of the loaded data
+ * Once the rows are ordered by their timestamps, the timestamp column itself is the sorted index --
+ * any time window [from, to) is one contiguous range of rows, found by two binary searches (O(log n)),
+ * so the statistics over the window can be computed without reloading or filtering the data
+ */
+
+/**
+ * Contiguous range of rows [begin, end)
+ */
+struct index_range {
+    /** First row of the range */
+    size_t begin = 0;
+    /** One past the last row of the range */
+    size_t end = 0;
+
+    /**
+     * Number of rows in the range
+     * @return Number of rows
+     */
+    [[nodiscard]] size_t size() const {
+        return end - begin;
+    }
+};
+
+/**
+ * Order the rows by their timestamps (stable -- rows with the same timestamp keep their order)
+ * The data files are normally already ordered, which is checked first and then nothing else is done
+ * Otherwise the rows are permuted (all the columns), which does not change CV nor MAD of the whole data
+ * This function has to be implemented in here (.h), because of the template
+ * @tparam exec_policy Execution policy (std::execution::seq or std::execution::par)
+ * @param policy Execution policy
+ * @param data Data with the timestamps (data.t)
+ */
+template <typename exec_policy>
+void sort_by_time(exec_policy policy, patient_data &data) {
+    if (std::is_sorted(policy, data.t.begin(), data.t.end()))
+        return;
+
+    /* Permutation of the rows by the timestamps */
+    std::vector<size_t> order(data.t.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(policy, order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return data.t[a] < data.t[b];
+    });
+
+    /* Apply the permutation to all the columns */
+    const auto permute = [&](auto &column) {
+        std::remove_reference_t<decltype(column)> sorted(column.size());
+        std::transform(policy, order.begin(), order.end(), sorted.begin(), [&](const size_t row) {
+            return column[row];
+        });
+        column.swap(sorted);
+    };
+    permute(data.x);
+    permute(data.y);
+    permute(data.z);
+    permute(data.t);
+}
+
+/**
+ * Find the rows of the time window [from, to) -- the rows have to be ordered by time (see sort_by_time)
+ * @param data Data with the timestamps (data.t)
+ * @param from Start of the window (microseconds since the epoch, inclusive)
+ * @param to End of the window (microseconds since the epoch, exclusive)
+ * @return Range of the rows inside the window (empty if there are none)
+ */
+index_range time_range(const patient_data &data, int64_t from, int64_t to);
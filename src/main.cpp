@@ -5,9 +5,13 @@
 
 #include "utils/arg_parser.h"
 #include "dataloader/dataloader.h"
+#include "dataloader/binary_cache.h"
+#include "dataloader/time_index.h"
 #include "calculations/cpu/cpu_comps.h"
 #include "calculations/gpu/gpu_comps.h"
 #include "my_drawing/svg_generator.h"
+#include "benchmarks/benchmarks.h"
+#include "utils/bounded_queue.h"
 
 /**
  * Parses the arguments using the arg_parser class
@@ -26,6 +30,20 @@ std::map<std::string, std::string> parse_args(int argc, char **argv) {
     parser.add_option(option("--vec", "Use vectorized computation (sequential by default)", false, false));
     parser.add_option(option("--gpu", "Use GPU computation (CPU by default)", false, false));
     parser.add_option(option("--all", "Use all available policies combinations (used for graphs)", false, false));
+    parser.add_option(option("--mad", "Algorithm of the medians in MAD: sort, select, approx (default: sort)", true, false));
+    parser.add_option(option("--sketch_k", "Accuracy parameter of the quantile sketches of --mad approx (default: 200, at least 50)", true, false));
+    parser.add_option(option("--sort", "Sort: merge, radix, sample (default: merge; the GPU uses bitonic sort, or radix)", true, false));
+    parser.add_option(option("--isa", "Instruction set of the vectorized computations: scalar, sse42, avx2, avx512 (default: the best one supported by the CPU)", true, false));
+    parser.add_option(option("--fused", "Compute X, Y and Z together: one pass for the sums, the MADs concurrently", false, false));
+    parser.add_option(option("--incremental", "Batches (-n) extend the previous one: only the new data is summed, sorted and merged", false, false));
+    parser.add_option(option("--loader", "Data loader to use: std, fast, super_fast, parallel, mmap, stream (default: parallel)", true, false));
+    parser.add_option(option("--cache", "Use a binary columnar cache next to each data file (written on the first load, used afterwards)", false, false));
+    parser.add_option(option("--from", "Start of the time window, \"YYYY-MM-DD HH:MM:SS[.ffffff]\" (inclusive) (default: first row)", true, false));
+    parser.add_option(option("--to", "End of the time window, \"YYYY-MM-DD HH:MM:SS[.ffffff]\" (exclusive) (default: last row)", true, false));
+    parser.add_option(option("--rolling", "Rolling window of the CV / MAD time series: N (samples), Ns or Nms (time) (default: none)", true, false));
+    parser.add_option(option("--prefetch", "Number of files loaded ahead while the current one is computed (-d mode) (default: 0)", true, false));
+    parser.add_option(option("--huge_pages", "Back the large data arrays by transparent huge pages (Linux only)", false, false));
+    parser.add_option(option("--bench", "Run a benchmark instead of the computations: loaders, parsers, memory, sorts, gpu_sorts, approx", true, false));
     parser.add_option(option("--no_graphs", "Do not plot the results (default: plot the results)", false, false));
     parser.add_option(option("-h", "Print this help message", false, false));
     parser.add_option(option("--help", "Print this help message", false, false));
@@ -46,7 +64,8 @@ std::vector<std::string> get_files(std::map<std::string, std::string> &args) {
     const std::filesystem::path path = dirpath.empty() ? filepath : dirpath;
     if (std::filesystem::is_directory(path))
         for (const auto &entry : std::filesystem::directory_iterator(path)) {
-            if (entry.is_regular_file())
+            /* Cache files (--cache flag) live next to the data files, but they are not data files */
+            if (entry.is_regular_file() && !is_cache_file(entry.path().string()))
                 files.push_back(entry.path().string());
         }
     else
@@ -62,6 +81,47 @@ std::vector<std::string> get_files(std::map<std::string, std::string> &args) {
     return files;
 }
 
+/**
+ * Load the data from the file using the loader chosen by the user (--loader flag)
+ * @param loader Name of the loader (std, fast, super_fast, parallel, mmap, stream)
+ * @param file File to be loaded
+ * @param policy Policy for the parallel loaders
+ * @param cache Whether the binary cache should be used (--cache flag)
+ * @param with_time Whether the timestamps should be loaded too (--from / --to flags, --rolling flag by time)
+ * @param data Data structure to store the loaded data
+ */
+void load_file(
+    const std::string &loader,
+    const std::string &file,
+    const std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> &policy,
+    bool cache,
+    bool with_time,
+    patient_data &data
+) {
+    /* Valid cache -- no parsing at all */
+    if (cache && load_data_cache(file, data, with_time)) {
+        std::cout << "Loaded from cache " << cache_path(file) << std::endl;
+        return;
+    }
+
+    if (loader == "std")
+        load_data(file, data, with_time);
+    else if (loader == "fast")
+        load_data_fast(file, data, with_time);
+    else if (loader == "super_fast")
+        load_data_super_fast(file, data, with_time);
+    else if (loader == "mmap")
+        std::visit([&](auto &&exec) { load_data_mmap(exec, file, data, with_time); }, policy);
+    else if (loader == "stream")
+        load_data_stream(file, data, std::holds_alternative<std::execution::sequenced_policy>(policy) ? 1 : std::thread::hardware_concurrency(), stream_block_size, with_time);
+    else
+        std::visit([&](auto &&exec) { load_data_parallel(exec, file, data, with_time); }, policy);
+
+    /* First load of the file -- write the cache for the next runs */
+    if (cache)
+        save_data_cache(file, data);
+}
+
 /**
  * Choose the policies for computations
  * @param args Arguments
@@ -108,68 +168,260 @@ void choose_policies(
         comp = vec_comp();
     if (gpu)
         comp = gpu_comps();
+
+    comp_options options;
+
+    /* Choose the algorithm of the medians in MAD */
+    if (args.find("--mad") != args.end()) {
+        if (args["--mad"] == "select") {
+            options.mad = mad_algorithm::select;
+        } else if (args["--mad"] == "approx") {
+            options.mad = mad_algorithm::approx;
+        } else if (args["--mad"] != "sort") {
+            std::cerr << "Unknown MAD algorithm: " << args["--mad"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.find("--sketch_k") != args.end()) {
+        options.sketch_k = std::stoul(args["--sketch_k"]);
+        if (options.sketch_k < kll_min_k) {
+            std::cerr << "Sketch accuracy parameter too small (at least " << kll_min_k << "): " << args["--sketch_k"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options.mad == mad_algorithm::approx)
+        std::cout << "Using quantile sketches (KLL, k = " << options.sketch_k << ", rank error " << kll_sketch::rank_error(options.sketch_k) * 100.0 << " %) for the medians in MAD..." << std::endl;
+    else
+        std::cout << "Using " << (options.mad == mad_algorithm::sort ? "sort" : "selection") << " for the medians in MAD..." << std::endl;
+
+    /* Choose the sort (CPU, the GPU has only the bitonic and the radix sort) */
+    if (args.find("--sort") != args.end()) {
+        if (args["--sort"] == "radix") {
+            options.sort = sort_algorithm::radix;
+        } else if (args["--sort"] == "sample") {
+            options.sort = sort_algorithm::sample;
+        } else if (args["--sort"] != "merge") {
+            std::cerr << "Unknown sort: " << args["--sort"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options.mad == mad_algorithm::sort) {
+        const std::string sort_name = options.sort == sort_algorithm::merge ? "merge" : options.sort == sort_algorithm::radix ? "radix" : "sample";
+        std::cout << "Using " << sort_name << " sort on the CPU, " << (options.sort == sort_algorithm::radix ? "radix" : "bitonic") << " sort on the GPU..." << std::endl;
+    }
+
+    /* Choose the instruction set of the vectorized computations (the best one supported by the CPU by default) */
+    if (args.find("--isa") != args.end()) {
+        const auto isa = std::find_if(std::begin(simd_isas), std::end(simd_isas), [&](const simd_isa candidate) { return args["--isa"] == simd_isa_name(candidate); });
+        if (isa == std::end(simd_isas)) {
+            std::cerr << "Unknown instruction set: " << args["--isa"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!simd_isa_supported(*isa)) {
+            std::cerr << "Instruction set not supported by the CPU: " << args["--isa"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        options.isa = *isa;
+    }
+    if (policy_v == "vec" && !gpu && !all)
+        std::cout << "Using " << simd_isa_name(options.isa) << " kernels for the vectorized computation..." << std::endl;
+
+    /* Compute X, Y and Z together */
+    options.fused = args.find("--fused") != args.end();
+    if (options.fused)
+        std::cout << "Computing X, Y and Z together (fused sums, concurrent MADs)..." << std::endl;
+
+    /* Incremental batches always take the medians from the sorted prefix -- the full recompute next to it has to be the same algorithm */
+    if (args.find("--incremental") != args.end() && (options.mad != mad_algorithm::sort || options.fused)) {
+        std::cerr << "--incremental works only with --mad sort and without --fused" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::visit([&](auto &&comp) { comp.set_options(options); }, comp);
+}
+
+/**
+ * Create the computation with the given options (for the --all flag)
+ * @tparam comp_type Computation class (seq_comp, vec_comp or gpu_comps)
+ * @param options Options of the computations
+ * @return Computation
+ */
+template <typename comp_type>
+comp_type make_comp(const comp_options &options) {
+    comp_type comp;
+    comp.set_options(options);
+    return comp;
+}
+
+/**
+ * One policy combination of the --all flag
+ */
+struct policy_combination {
+    /** Label of the combination in the graphs */
+    std::string label;
+    /** Name of the combination (printed out before its computations) */
+    std::string name;
+    /** Policy for parallel and vectorized computation */
+    std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> policy;
+    /** Computation -- created only once, so that its workspace (and the OpenCL setup) is reused for all the files and batches */
+    std::variant<seq_comp, vec_comp, gpu_comps> comp;
+};
+
+/**
+ * Create all the policy combinations (for the --all flag) -- SerSeq, SerVec, ParSeq, ParVec and GPU
+ * The vectorized combinations are created for every instruction set supported by the CPU (one line per instruction set
+ * in the graphs)
+ * @param options Options of the computations (the same ones for all the policy combinations, except the instruction set)
+ * @return Policy combinations
+ */
+std::vector<policy_combination> make_policy_combinations(const comp_options &options) {
+    std::vector<policy_combination> combinations;
+
+    /* Vectorized computation with each instruction set */
+    const auto add_vectorized = [&](const std::string &label, const std::string &name, const auto policy) {
+        for (const auto isa : simd_isas) {
+            if (!simd_isa_supported(isa))
+                continue;
+
+            auto isa_options = options;
+            isa_options.isa = isa;
+            const std::string isa_name = simd_isa_name(isa);
+            combinations.push_back({label + " " + isa_name, name + " (" + isa_name + ")", policy, make_comp<vec_comp>(isa_options)});
+        }
+    };
+
+    combinations.push_back({"SerSeq", "Serial sequential computation", std::execution::seq, make_comp<seq_comp>(options)});
+    add_vectorized("SerVec", "Serial vectorized computation", std::execution::seq);
+    combinations.push_back({"ParSeq", "Parallel sequential computation", std::execution::par, make_comp<seq_comp>(options)});
+    add_vectorized("ParVec", "Parallel vectorized computation", std::execution::par);
+    combinations.push_back({"GPU", "GPU computation", std::execution::par, make_comp<gpu_comps>(options)});
+
+    return combinations;
+}
+
+/**
+ * Get the transfers between the host and the device of the computation (zeros for the CPU computations)
+ * @param comp Computation (sequential, vectorized or GPU)
+ * @return Transfer counters
+ */
+transfer_stats get_transfer_stats(const std::variant<seq_comp, vec_comp, gpu_comps> &comp) {
+    return std::visit([](auto &&comp) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(comp)>, gpu_comps>)
+            return comp.get_transfer_stats();
+        else
+            return transfer_stats{};
+    }, comp);
+}
+
+/**
+ * Print the transfers between the host and the device since the given counters (GPU computations only)
+ * @param comp Computation (sequential, vectorized or GPU)
+ * @param before Transfer counters before the computations
+ */
+void print_transfer_stats(const std::variant<seq_comp, vec_comp, gpu_comps> &comp, const transfer_stats &before) {
+    if (!std::holds_alternative<gpu_comps>(comp))
+        return;
+
+    const auto after = get_transfer_stats(comp);
+    std::cout << "GPU transfers: " << after.bytes_uploaded - before.bytes_uploaded << " bytes uploaded, "
+              << after.bytes_downloaded - before.bytes_downloaded << " bytes downloaded, "
+              << after.allocations - before.allocations << " buffer allocations" << std::endl;
 }
 
 /**
  * Execute the computations for the given repetitions
  * This is made into function for easy handling of the --all flag (also for better readability)
  * @param data Data to be used for computations
+ * @param first_data_point First data point to be used for computation (start of the time window)
  * @param num_data_points Number of data points to be used for computation (deep copy of the data param)
  * @param repetitions Number of repetitions (computation is repeated n number of times -> median of the measurements)
  * @param policy Policy for parallel and vectorized computation
- * @param comp Computation (sequential or vectorized)
+ * @param comp Computation (sequential or vectorized) -- by reference, so its workspace is reused between the calls
  * @param results Vector to store the results for later plotting
  */
 void execute_computations_for_repetitions(
     patient_data &data,
+    const size_t first_data_point,
     const size_t num_data_points,
     const size_t repetitions,
     std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> policy,
-    std::variant<seq_comp, vec_comp, gpu_comps> comp,
+    std::variant<seq_comp, vec_comp, gpu_comps> &comp,
     std::vector<double> &results
 ) {
     /* For each repetition -- purpose for median of the measured times (3 hard coded as X, Y, Z) */
     std::vector<std::vector<long long int>> measured_times(3, std::vector<long long int>(repetitions));
     std::vector<std::vector<decimal>> mads(3, std::vector<decimal>(repetitions));
     std::vector<std::vector<decimal>> coef_vars(3, std::vector<decimal>(repetitions));
+    /* X, Y and Z together (--fused flag) -- one time for all of them */
+    const bool fused = std::visit([](auto &&comp) { return comp.get_options().fused; }, comp);
+    std::vector<decimal> series_mads, series_coef_vars;
 
     for (size_t i = 0; i < repetitions; i++) {
         std::cout << "Repetition " << i + 1 << "..." << std::endl;
+        const auto allocations = std::visit([](auto &&comp) { return comp.get_allocations(); }, comp);
+        const auto transfers = get_transfer_stats(comp);
 
         /* Create deep copies of the data */
-        std::vector<decimal> copy_x(data.x.begin(), data.x.begin() + static_cast<int>(num_data_points));
-        std::vector<decimal> copy_y(data.y.begin(), data.y.begin() + static_cast<int>(num_data_points));
-        std::vector<decimal> copy_z(data.z.begin(), data.z.begin() + static_cast<int>(num_data_points));
+        const auto first = static_cast<long>(first_data_point);
+        const auto last = static_cast<long>(first_data_point + num_data_points);
+        decimal_vector copy_x(data.x.begin() + first, data.x.begin() + last);
+        decimal_vector copy_y(data.y.begin() + first, data.y.begin() + last);
+        decimal_vector copy_z(data.z.begin() + first, data.z.begin() + last);
 
         /* Compute the mean absolute deviation and coefficient of variation for X, Y and Z respectively */
-        std::vector<std::vector<decimal>> vectors = {copy_x, copy_y, copy_z};
-        /* For each data vector */
-        for (size_t j = 0; j < vectors.size(); j++) {
+        std::vector<decimal_vector> vectors = {copy_x, copy_y, copy_z};
+        if (fused) {
             auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
 
-            /*
-             * Actual computation -- uses the variant and the visitor pattern
-             * (mimics dynamic polymorphism, but with no runtime overhead)
-             */
-            auto coef_var = std::visit([&](auto &&comp) -> decimal {
-                return std::visit([&](auto &&exec) -> decimal {
-                    return comp.compute_coef_var(exec, vectors[j]);  /* Order matters for CPU -> GPU data transfer */
-                }, policy);
-            }, comp);
-            auto mad = std::visit([&](auto &&comp) -> decimal {
-                return std::visit([&](auto &&exec) -> decimal {
-                    return comp.compute_mad(exec, vectors[j]);  /* Order matters -- this modifies the original array */
+            /* All the series at once -- fused sums, concurrent MADs (modifies the original arrays) */
+            std::visit([&](auto &&comp) {
+                std::visit([&](auto &&exec) {
+                    comp.compute_series(exec, vectors, series_coef_vars, series_mads);
                 }, policy);
             }, comp);
 
             auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
             auto computed_in = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-            /* Store the measured times for median */
-            measured_times[j][i] = computed_in;
-            mads[j][i] = mad;
-            coef_vars[j][i] = coef_var;
+            /* Store the measured time (of all the series) for median */
+            for (size_t j = 0; j < vectors.size(); j++) {
+                measured_times[j][i] = computed_in;
+                mads[j][i] = series_mads[j];
+                coef_vars[j][i] = series_coef_vars[j];
+            }
+        } else {
+            /* For each data vector */
+            for (size_t j = 0; j < vectors.size(); j++) {
+                auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+
+                /*
+                 * Actual computation -- uses the variant and the visitor pattern
+                 * (mimics dynamic polymorphism, but with no runtime overhead)
+                 */
+                auto coef_var = std::visit([&](auto &&comp) -> decimal {
+                    return std::visit([&](auto &&exec) -> decimal {
+                        return comp.compute_coef_var(exec, vectors[j]);  /* Order matters for CPU -> GPU data transfer */
+                    }, policy);
+                }, comp);
+                auto mad = std::visit([&](auto &&comp) -> decimal {
+                    return std::visit([&](auto &&exec) -> decimal {
+                        return comp.compute_mad(exec, vectors[j]);  /* Order matters -- this modifies the original array */
+                    }, policy);
+                }, comp);
+
+                auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+                auto computed_in = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+                /* Store the measured times for median */
+                measured_times[j][i] = computed_in;
+                mads[j][i] = mad;
+                coef_vars[j][i] = coef_var;
+            }
         }
+
+        /* Allocations of the scratch buffers -- only until the workspace grows to the size of the data */
+        std::cout << "Workspace allocations: " << std::visit([](auto &&comp) { return comp.get_allocations(); }, comp) - allocations << std::endl;
+        print_transfer_stats(comp, transfers);
     }
 
     /* Print the median (and mean) of the measured times */
@@ -187,7 +439,109 @@ void execute_computations_for_repetitions(
 
         std::cout << "Mean absolute deviation: " << mad_med << std::endl;
         std::cout << "Coefficient of variation: " << coef_var_med << std::endl;
-        std::cout << "Time taken " << computed_in_med << "ms" << std::endl;
+        std::cout << "Time taken " << computed_in_med << "ms" << (fused ? " (X, Y and Z together)" : "") << std::endl;
+
+        /* Store the medians for later plotting */
+        results.emplace_back(mad_med);
+        results.emplace_back(coef_var_med);
+        results.emplace_back(computed_in_med);
+    }
+
+    std::cout << std::endl;
+}
+
+/**
+ * Execute the incremental computations of one batch for the given repetitions (--incremental flag)
+ * The batch extends the prefix of the previous batch -- only the new data points are summed, sorted and merged into
+ * the sorted prefix; the full recompute of the whole batch is measured too, for comparison
+ * Every repetition extends a copy of the state of the previous batch (the copy is not measured), the state of the last
+ * repetition is kept for the next batch
+ * @param data Data to be used for computations
+ * @param first_data_point First data point to be used for computation (start of the time window)
+ * @param prev_data_points Number of data points of the previous batch (0 for the first batch)
+ * @param num_data_points Number of data points of this batch
+ * @param repetitions Number of repetitions (computation is repeated n number of times -> median of the measurements)
+ * @param policy Policy for parallel and vectorized computation
+ * @param comp Computation (sequential or vectorized) -- by reference, so its workspace is reused between the calls
+ * @param states States of the prefixes of X, Y and Z (extended by this batch)
+ * @param results Vector to store the results for later plotting (the time of the incremental computation)
+ */
+void execute_incremental_for_repetitions(
+    const patient_data &data,
+    const size_t first_data_point,
+    const size_t prev_data_points,
+    const size_t num_data_points,
+    const size_t repetitions,
+    std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> policy,
+    std::variant<seq_comp, vec_comp, gpu_comps> &comp,
+    std::vector<prefix_state> &states,
+    std::vector<double> &results
+) {
+    /* For each repetition -- purpose for median of the measured times (3 hard coded as X, Y, Z) */
+    std::vector<std::vector<long long int>> measured_times(3, std::vector<long long int>(repetitions));
+    std::vector<std::vector<long long int>> full_times(3, std::vector<long long int>(repetitions));
+    std::vector<std::vector<decimal>> mads(3, std::vector<decimal>(repetitions));
+    std::vector<std::vector<decimal>> coef_vars(3, std::vector<decimal>(repetitions));
+    const std::vector<const decimal_vector *> columns = {&data.x, &data.y, &data.z};
+
+    for (size_t i = 0; i < repetitions; i++) {
+        std::cout << "Repetition " << i + 1 << "..." << std::endl;
+
+        for (size_t j = 0; j < columns.size(); j++) {
+            const auto &column = *columns[j];
+            const auto first = column.begin() + static_cast<long>(first_data_point);
+
+            /* Incremental -- only the new data points, on top of the previous batch */
+            prefix_state state = states[j];
+            decimal_vector chunk(first + static_cast<long>(prev_data_points), first + static_cast<long>(num_data_points));
+
+            auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+            std::visit([&](auto &&comp) {
+                std::visit([&](auto &&exec) {
+                    comp.extend_prefix(exec, state, chunk, coef_vars[j][i], mads[j][i]);
+                }, policy);
+            }, comp);
+            auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+            measured_times[j][i] = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+            /* Full recompute of the whole batch (the same computations as without --incremental) */
+            decimal_vector copy(first, first + static_cast<long>(num_data_points));
+
+            start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+            std::visit([&](auto &&comp) {
+                std::visit([&](auto &&exec) {
+                    (void) comp.compute_coef_var(exec, copy);  /* Order matters for CPU -> GPU data transfer */
+                    (void) comp.compute_mad(exec, copy);
+                }, policy);
+            }, comp);
+            end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+            full_times[j][i] = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+            /* The last repetition continues with the next batch */
+            if (i == repetitions - 1)
+                states[j] = std::move(state);
+        }
+    }
+
+    /* Print the median of the measured times */
+    std::vector<std::string> labels = {"X", "Y", "Z"};
+    for (size_t i = 0; i < labels.size(); i++) {
+        std::cout << "For " << labels[i] << " data:" << std::endl;
+
+        /* Pick the median */
+        std::sort(measured_times[i].begin(), measured_times[i].end());
+        std::sort(full_times[i].begin(), full_times[i].end());
+        std::sort(mads[i].begin(), mads[i].end());
+        std::sort(coef_vars[i].begin(), coef_vars[i].end());
+        const auto computed_in_med = static_cast<double>(measured_times[i][measured_times[i].size() / 2] + measured_times[i][(measured_times[i].size() - 1) / 2]) / 2.0;
+        const auto full_med = static_cast<double>(full_times[i][full_times[i].size() / 2] + full_times[i][(full_times[i].size() - 1) / 2]) / 2.0;
+        const auto mad_med = (mads[i][mads[i].size() / 2] + mads[i][(mads[i].size() - 1) / 2]) / 2.0;
+        const auto coef_var_med = (coef_vars[i][coef_vars[i].size() / 2] + coef_vars[i][(coef_vars[i].size() - 1) / 2]) / 2.0;
+
+        std::cout << "Mean absolute deviation: " << mad_med << std::endl;
+        std::cout << "Coefficient of variation: " << coef_var_med << std::endl;
+        std::cout << "Time taken " << computed_in_med << "ms (incremental, " << num_data_points - prev_data_points << " new data points)" << std::endl;
+        std::cout << "Time taken " << full_med << "ms (full recompute)" << std::endl;
 
         /* Store the medians for later plotting */
         results.emplace_back(mad_med);
@@ -205,8 +559,9 @@ void execute_computations_for_repetitions(
  * @param results Results to be plotted (Y axis)
  * @param batches Batches for the X axis
  * @param all All policy combinations used (--all flag)
+ * @param combination_labels Labels of the policy combinations (--all flag)
  */
-void plot_results(const std::vector<double> &results, std::vector<double> &batches, const std::vector<std::string> &files, bool all) {
+void plot_results(const std::vector<double> &results, std::vector<double> &batches, const std::vector<std::string> &files, bool all, const std::vector<std::string> &combination_labels) {
     std::cout << "Plotting the results..." << std::endl;
 
     /* Prepare res directory for the plots, if it does not exist */
@@ -219,8 +574,8 @@ void plot_results(const std::vector<double> &results, std::vector<double> &batch
     /* Plot the results for each file */
     for (size_t i = 0; i < files.size(); i++) {
         if (all) {
-            /* 5 results for each data point (SerSeq, SerVec, ParSeq, ParVec, GPU) */
-            const std::vector<std::string> labels = {"SerSeq", "SerVec", "ParSeq", "ParVec", "GPU"};
+            /* One result for each policy combination for each data point (SerSeq, SerVec per instruction set, ParSeq, ...) */
+            const auto &labels = combination_labels;
             /* 3 results per data point (X, Y, Z) */
             const std::vector<std::string> sub_labels = {"X", "Y", "Z"};
 
@@ -270,16 +625,20 @@ void plot_results(const std::vector<double> &results, std::vector<double> &batch
 
                 /* Plot the results */
                 auto title = "Time taken for computation (" + sub_labels[j] + ")";
-                std::vector<std::vector<double>> x_values_list = {batches, batches, batches, batches, batches};
-                std::vector<std::vector<double>> y_values_list = {times[0][j], times[1][j], times[2][j], times[3][j], times[4][j]};
+                std::vector<std::vector<double>> x_values_list(labels.size(), batches);
+                std::vector<std::vector<double>> y_values_list(labels.size());
+                for (size_t k = 0; k < labels.size(); k++)
+                    y_values_list[k] = times[k][j];
                 plot_line_chart(name_times, x_values_list, y_values_list, title, "Data batch size", "Time (ms)", labels);
 
                 title = "Mean Absolute Deviation (" + sub_labels[j] + ")";
-                y_values_list = {mads[0][j], mads[1][j], mads[2][j], mads[3][j], mads[4][j]};
+                for (size_t k = 0; k < labels.size(); k++)
+                    y_values_list[k] = mads[k][j];
                 plot_line_chart(name_mads, x_values_list, y_values_list, title, "Data batch size", "MAD", labels);
 
                 title = "Coefficient of Variation (" + sub_labels[j] + ")";
-                y_values_list = {cvs[0][j], cvs[1][j], cvs[2][j], cvs[3][j], cvs[4][j]};
+                for (size_t k = 0; k < labels.size(); k++)
+                    y_values_list[k] = cvs[k][j];
                 plot_line_chart(name_cvs, x_values_list, y_values_list, title, "Data batch size", "CV", labels);
             }
             /* If only one policy is used, plot the results for X, Y, Z instead */
@@ -344,73 +703,243 @@ void plot_results(const std::vector<double> &results, std::vector<double> &batch
     std::cout << "You can find the plots in the res directory." << std::endl;
 }
 
+/**
+ * Time window of the computations (--from / --to flags)
+ */
+struct time_window {
+    /** Whether the window is used (the timestamps are loaded only then) */
+    bool enabled = false;
+    /** Start of the window (microseconds since the epoch, inclusive) */
+    int64_t from = std::numeric_limits<int64_t>::min();
+    /** End of the window (microseconds since the epoch, exclusive) */
+    int64_t to = std::numeric_limits<int64_t>::max();
+};
+
+/**
+ * Rolling window statistics (--rolling flag)
+ */
+struct rolling_statistics {
+    /** Whether the CV / MAD time series are computed */
+    bool enabled = false;
+    /** Window of the time series (by the number of samples or by time) */
+    rolling_window window;
+};
+
+/**
+ * Compute the CV / MAD time series of the rolling window over X, Y and Z and print their summary
+ * @param data Data (ordered by time, if the window is given by time)
+ * @param rows Rows of the time window (--from / --to flags)
+ * @param window Rolling window
+ * @param policy Policy for parallel and vectorized computation
+ * @param comp Computation (sequential or vectorized) -- by reference, so its workspace is reused between the calls
+ */
+void execute_rolling(
+    const patient_data &data,
+    const index_range &rows,
+    const rolling_window &window,
+    const std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> &policy,
+    std::variant<seq_comp, vec_comp, gpu_comps> &comp
+) {
+    if (window.by_time())
+        std::cout << "Rolling window of the last " << static_cast<double>(window.span) / 1e6 << "s..." << std::endl;
+    else
+        std::cout << "Rolling window of the last " << window.samples << " samples..." << std::endl;
+
+    /* Rows of the time window only */
+    const auto first = static_cast<long>(rows.begin);
+    const auto last = static_cast<long>(rows.end);
+    std::vector<int64_t> times;
+    if (window.by_time())
+        times.assign(data.t.begin() + first, data.t.begin() + last);
+
+    const std::vector<std::pair<std::string, const decimal_vector *>> columns = {{"X", &data.x}, {"Y", &data.y}, {"Z", &data.z}};
+    std::vector<decimal> coef_vars, mads;
+    for (const auto &[label, column] : columns) {
+        const decimal_vector values(column->begin() + first, column->begin() + last);
+
+        auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+        std::visit([&](auto &&comp) {
+            std::visit([&](auto &&exec) {
+                comp.compute_rolling(exec, values, times, window, coef_vars, mads);
+            }, policy);
+        }, comp);
+        auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+        auto computed_in = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        /* Summary of the time series (the series themselves are returned by compute_rolling) */
+        const auto [min_mad, max_mad] = std::minmax_element(mads.begin(), mads.end());
+        const auto [min_coef_var, max_coef_var] = std::minmax_element(coef_vars.begin(), coef_vars.end());
+        std::cout << "For " << label << " data:" << std::endl;
+        std::cout << "Computed " << mads.size() << " windows in " << computed_in << "ms" << std::endl;
+        std::cout << "Mean absolute deviation: " << *min_mad << " to " << *max_mad << " (last window " << mads.back() << ")" << std::endl;
+        std::cout << "Coefficient of variation: " << *min_coef_var << " to " << *max_coef_var << " (last window " << coef_vars.back() << ")" << std::endl;
+    }
+
+    std::cout << std::endl;
+}
+
+/**
+ * Data file loaded (possibly ahead of time by the prefetching thread)
+ */
+struct loaded_file {
+    /** Path to the file */
+    std::string file;
+    /** Loaded data */
+    patient_data data;
+    /** Load time in milliseconds */
+    long long loaded_in = 0;
+};
+
+/**
+ * Load the data file and measure the load time
+ * @param loader Data loader to be used (--loader flag)
+ * @param file File to be loaded
+ * @param policy Policy for the parallel loaders
+ * @param cache Whether the binary cache should be used (--cache flag)
+ * @param with_time Whether the timestamps should be loaded too (--from / --to flags, --rolling flag by time)
+ * @return Loaded file
+ */
+loaded_file load_file_timed(
+    const std::string &loader,
+    const std::string &file,
+    const std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> &policy,
+    bool cache,
+    bool with_time
+) {
+    loaded_file loaded;
+    loaded.file = file;
+
+    auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+    load_file(loader, file, policy, cache, with_time, loaded.data);
+    auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
+    loaded.loaded_in = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    return loaded;
+}
+
 /**
  * Execute the computations
  * @param files Files to be processed
+ * @param loader Data loader to be used (--loader flag)
+ * @param cache Whether the binary cache should be used (--cache flag)
+ * @param window Time window of the computations (--from / --to flags)
+ * @param rolling Rolling window statistics (--rolling flag)
+ * @param incremental Whether each batch extends the previous one (--incremental flag)
+ * @param prefetch Number of files loaded ahead by a separate thread while the current one is computed (0 = no prefetching)
  * @param repetitions Repetitions for each computation
  * @param num_batches Number of batches to split the data into
  * @param policy Policy for parallel and vectorized computation
  * @param comp Computation (sequential or vectorized)
- * @param all Whether all policy combinations should be used (--all flag)
+ * @param combinations All the policy combinations (--all flag, empty otherwise)
  * @param results Results to be plotted (Y axis)
  * @param batches Batches for the X axis
  */
 void execute_computations(
     const std::vector<std::string> &files,
+    const std::string &loader,
+    bool cache,
+    const time_window &window,
+    const rolling_statistics &rolling,
+    bool incremental,
+    const size_t prefetch,
     const size_t repetitions,
     const size_t num_batches,
     const std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> &policy,
-    const std::variant<seq_comp, vec_comp, gpu_comps> &comp,
-    bool all,
+    std::variant<seq_comp, vec_comp, gpu_comps> &comp,
+    std::vector<policy_combination> &combinations,
     std::vector<double> &results,
     std::vector<double> &batches
 ) {
-    /* For each file we are processing */
-    for (auto &file : files) {
-        /* Load the data */
-        patient_data data;
+    /* Timestamps are needed by the time window and by the rolling window given by time */
+    const bool with_time = window.enabled || (rolling.enabled && rolling.window.by_time());
 
-        std::cout << "Loading data from " << file << "..." << std::endl;
-        auto start = std::chrono::high_resolution_clock::now();  /* Time measurement */
+    /* All the computations for one loaded file */
+    const auto compute_file = [&](loaded_file &loaded) {
+        auto &data = loaded.data;
 
-        std::visit([&](auto &&exec) {
-            load_data_parallel(exec, file, data);
-        }, policy);
-
-        auto end = std::chrono::high_resolution_clock::now();  /* Time measurement */
-        auto loaded_in = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-        std::cout << "Loaded in " << loaded_in << "ms" << std::endl << std::endl;
+        std::cout << "Loading data from " << loaded.file << "..." << (prefetch ? " (prefetched)" : "") << std::endl;
+        std::cout << "Loaded in " << loaded.loaded_in << "ms" << std::endl << std::endl;
 
         /* Print the number of loaded data (for checking) */
         std::cout << "Loaded " << data.x.size() << " X data" << std::endl;
         std::cout << "Loaded " << data.y.size() << " Y data" << std::endl;
         std::cout << "Loaded " << data.z.size() << " Z data" << std::endl << std::endl;
 
+        /* Rows of the time window -- the timestamps are the sorted time index, so it is just two binary searches */
+        index_range rows = {0, data.x.size()};
+        if (with_time)
+            std::visit([&](auto &&exec) { sort_by_time(exec, data); }, policy);
+        if (window.enabled) {
+            rows = time_range(data, window.from, window.to);
+            if (!rows.size()) {
+                std::cerr << "No data in the time window in file: " << loaded.file << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            std::cout << "Time window contains rows " << rows.begin << " to " << rows.end << " (" << rows.size() << " data points)" << std::endl << std::endl;
+        }
+
+        /* States of the prefixes of X, Y and Z for each policy combination (--incremental flag) */
+        std::vector<std::vector<prefix_state>> states(std::max<size_t>(combinations.size(), 1), std::vector<prefix_state>(3));
+        size_t prev_data_points = 0;
+
         /* For each split chunk (batch) of the loaded data */
         for (size_t i = 0; i < num_batches; i++) {
-            const auto num_data_points = i != num_batches - 1 ? data.x.size() / num_batches * (i + 1) : data.x.size();
+            const auto num_data_points = i != num_batches - 1 ? rows.size() / num_batches * (i + 1) : rows.size();
             batches.emplace_back(static_cast<double>(num_data_points));
-            std::cout << "Using " << num_data_points << " data points for computation..." << std::endl << std::endl;
+            std::cout << "Using " << num_data_points << " data points for computation..." << (incremental ? " (incremental)" : "") << std::endl << std::endl;
 
             /* If we are using all combinations of policies -- one more "for loop" before the repetitions */
-            if (all) {
+            if (!combinations.empty()) {
                 /* For each policy combination */
                 std::cout << "Using all policy combinations..." << std::endl;
-                std::cout << "Serial sequential computation..." << std::endl;
-                execute_computations_for_repetitions(data, num_data_points, repetitions, std::execution::seq, seq_comp(), results);
-                std::cout << "Serial vectorized computation..." << std::endl;
-                execute_computations_for_repetitions(data, num_data_points, repetitions, std::execution::seq, vec_comp(), results);
-                std::cout << "Parallel sequential computation..." << std::endl;
-                execute_computations_for_repetitions(data, num_data_points, repetitions, std::execution::par, seq_comp(), results);
-                std::cout << "Parallel vectorized computation..." << std::endl;
-                execute_computations_for_repetitions(data, num_data_points, repetitions, std::execution::par, vec_comp(), results);
-                std::cout << "GPU computation..." << std::endl;
-                execute_computations_for_repetitions(data, num_data_points, repetitions, std::execution::par, gpu_comps(), results);
-            } else {  /* If only one policy is used, go straight to repetitions */
-                execute_computations_for_repetitions(data, num_data_points, repetitions, policy, comp, results);
+                for (size_t c = 0; c < combinations.size(); c++) {
+                    auto &combination = combinations[c];
+                    std::cout << combination.name << "..." << std::endl;
+                    if (incremental)
+                        execute_incremental_for_repetitions(data, rows.begin, prev_data_points, num_data_points, repetitions, combination.policy, combination.comp, states[c], results);
+                    else
+                        execute_computations_for_repetitions(data, rows.begin, num_data_points, repetitions, combination.policy, combination.comp, results);
+                }
+            } else if (incremental) {  /* If only one policy is used, go straight to repetitions */
+                execute_incremental_for_repetitions(data, rows.begin, prev_data_points, num_data_points, repetitions, policy, comp, states[0], results);
+            } else {
+                execute_computations_for_repetitions(data, rows.begin, num_data_points, repetitions, policy, comp, results);
             }
+            prev_data_points = num_data_points;
+        }
+
+        /* Time series of the rolling window (over the rows of the time window) */
+        if (rolling.enabled)
+            execute_rolling(data, rows, rolling.window, policy, comp);
+    };
+
+    /* No prefetching -- for each file we are processing, load it and compute */
+    if (!prefetch) {
+        for (auto &file : files) {
+            auto loaded = load_file_timed(loader, file, policy, cache, with_time);
+            compute_file(loaded);
         }
+        return;
     }
+
+    /*
+     * Prefetching -- a producer thread loads the files (in order) into a bounded queue of loaded files,
+     * so the next files are loaded and parsed while the current one is being computed
+     * (at most prefetch files wait in the queue, one more is being loaded)
+     */
+    bounded_queue<loaded_file> loaded_files(prefetch);
+    std::thread producer([&]() {
+        for (auto &file : files)
+            if (!loaded_files.push(load_file_timed(loader, file, policy, cache, with_time)))
+                break;
+        loaded_files.close();
+    });
+
+    loaded_file loaded;
+    while (loaded_files.pop(loaded))
+        compute_file(loaded);
+
+    producer.join();
 }
 
 /**
@@ -432,6 +961,73 @@ int main(int argc, char **argv) {
     /* Number of repetitions and batches (or chunks) */
     const size_t repetitions = args.find("-r") != args.end() ? std::stoi(args["-r"]) : 1;
     const size_t num_batches = args.find("-n") != args.end() ? std::stoi(args["-n"]) : 1;
+    const size_t prefetch = args.find("--prefetch") != args.end() ? std::stoi(args["--prefetch"]) : 0;
+
+    /* Data loader */
+    const std::string loader = args.find("--loader") != args.end() ? args["--loader"] : "parallel";
+    const std::vector<std::string> loaders = {"std", "fast", "super_fast", "parallel", "mmap", "stream"};
+    if (std::find(loaders.begin(), loaders.end(), loader) == loaders.end()) {
+        std::cerr << "Unknown loader: " << loader << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    /* Time window (timestamps are loaded only if it is used) */
+    time_window window;
+    for (const auto &[flag, bound] : {std::make_pair("--from", &window.from), std::make_pair("--to", &window.to)}) {
+        if (args.find(flag) == args.end())
+            continue;
+
+        const auto &value = args[flag];
+        if (parse_datetime(value.data(), value.data() + value.size(), *bound) != value.data() + value.size()) {
+            std::cerr << "Invalid datetime (expected YYYY-MM-DD HH:MM:SS[.ffffff]): " << value << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        window.enabled = true;
+    }
+
+    /* Rolling window -- a number of samples, or a time span in seconds (s) or milliseconds (ms) */
+    rolling_statistics rolling;
+    if (args.find("--rolling") != args.end()) {
+        const auto &value = args["--rolling"];
+        const auto ends_with = [&value](const std::string &suffix) {
+            return value.size() > suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        if (ends_with("ms"))
+            rolling.window.span = static_cast<int64_t>(std::stod(value.substr(0, value.size() - 2)) * 1e3);
+        else if (ends_with("s"))
+            rolling.window.span = static_cast<int64_t>(std::stod(value.substr(0, value.size() - 1)) * 1e6);
+        else
+            rolling.window.samples = std::stoul(value);
+        if (rolling.window.samples == 0 && rolling.window.span <= 0) {
+            std::cerr << "Invalid rolling window (expected N samples, Ns or Nms): " << value << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        rolling.enabled = true;
+    }
+
+    /* Huge pages for all the following allocations */
+    huge_pages_enabled = args.find("--huge_pages") != args.end();
+
+    /* Benchmarks replace the computations entirely */
+    if (args.find("--bench") != args.end()) {
+        if (args["--bench"] == "loaders") {
+            benchmark_loaders(files, repetitions);
+        } else if (args["--bench"] == "parsers") {
+            benchmark_parsers(files, repetitions);
+        } else if (args["--bench"] == "memory") {
+            benchmark_memory(files, repetitions);
+        } else if (args["--bench"] == "sorts") {
+            benchmark_sorts(files, num_batches, repetitions, args.find("--no_graphs") == args.end());
+        } else if (args["--bench"] == "gpu_sorts") {
+            benchmark_gpu_sorts(files, num_batches, repetitions);
+        } else if (args["--bench"] == "approx") {
+            benchmark_approx(files, repetitions);
+        } else {
+            std::cerr << "Unknown benchmark: " << args["--bench"] << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+    }
 
     /* Choose the policies for computations */
     std::variant<std::execution::sequenced_policy, std::execution::parallel_policy> policy;
@@ -440,6 +1036,19 @@ int main(int argc, char **argv) {
     bool all = args.find("--all") != args.end();
     choose_policies(args, policy, comp, gpu, all);
 
+    /*
+     * Backends of all the policy combinations (--all flag) -- created only once, so that their workspaces
+     * (and the OpenCL setup) are reused for all the files and batches
+     * Options of the computations are the same ones for all the policy combinations
+     */
+    std::vector<policy_combination> combinations;
+    std::vector<std::string> combination_labels;
+    if (all) {
+        combinations = make_policy_combinations(std::visit([](auto &&comp) { return comp.get_options(); }, comp));
+        for (const auto &combination : combinations)
+            combination_labels.push_back(combination.label);
+    }
+
     /* Prepare structures to save the results for later plotting */
     std::vector<double> results;
     std::vector<double> batches;  /* This should correctly be size_t, not double, but for plotting purposes -- double */
@@ -453,11 +1062,11 @@ int main(int argc, char **argv) {
      * For each repetition, (deep) copy the data (purpose: median of the measured times)
      * For each vector X, Y, Z from the data, finally compute the MAD and CV
      */
-    execute_computations(files, repetitions, num_batches, policy, comp, all, results, batches);
+    execute_computations(files, loader, args.find("--cache") != args.end(), window, rolling, args.find("--incremental") != args.end(), prefetch, repetitions, num_batches, policy, comp, combinations, results, batches);
 
     /* Plot the results (if the user did not specify --no_graphs flag) */
     if (args.find("--no_graphs") == args.end())
-        plot_results(results, batches, files, all);
+        plot_results(results, batches, files, all, combination_labels);
 
     return EXIT_SUCCESS;
 }
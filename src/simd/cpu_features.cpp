@@ -0,0 +1,102 @@
+#include "simd/cpu_features.h"
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+/**
+ * Query the cpuid leaf
+ * @param leaf Leaf
+ * @param subleaf Subleaf
+ * @param regs EAX, EBX, ECX, EDX (output, zeros if the leaf is not supported)
+ */
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+    #ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (size_t i = 0; i < 4; i++)
+        regs[i] = static_cast<uint32_t>(info[i]);
+    #else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    #endif
+}
+
+/**
+ * Register states enabled by the OS (XCR0) -- only valid if the OSXSAVE bit is set
+ * @return XCR0
+ */
+static uint64_t xgetbv0() {
+    #ifdef _MSC_VER
+    return _xgetbv(0);
+    #else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+    #endif
+}
+
+/**
+ * The actual detection (see detect_simd_isa)
+ * @return Best supported instruction set
+ */
+static simd_isa detect() {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    if (max_leaf < 1)
+        return simd_isa::scalar;
+
+    cpuid(1, 0, regs);
+    const bool sse42 = (regs[2] >> 20) & 1;
+    const bool popcnt = (regs[2] >> 23) & 1;
+    const bool osxsave = (regs[2] >> 27) & 1;
+    const bool avx = (regs[2] >> 28) & 1;
+    if (!sse42 || !popcnt)
+        return simd_isa::scalar;
+    if (!osxsave || !avx || max_leaf < 7)
+        return simd_isa::sse42;
+
+    /* XMM and YMM state (bits 1, 2), opmask and ZMM state (bits 5, 6, 7) */
+    const uint64_t xcr0 = xgetbv0();
+    const bool os_avx = (xcr0 & 0x06) == 0x06;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    cpuid(7, 0, regs);
+    const bool avx2 = (regs[1] >> 5) & 1;
+    const bool avx512f = (regs[1] >> 16) & 1;
+    const bool avx512bw = (regs[1] >> 30) & 1;
+    if (!avx2 || !os_avx)
+        return simd_isa::sse42;
+    if (!avx512f || !avx512bw || !os_avx512)
+        return simd_isa::avx2;
+
+    return simd_isa::avx512;
+}
+
+simd_isa detect_simd_isa() {
+    static const simd_isa best = detect();
+    return best;
+}
+
+bool simd_isa_supported(simd_isa isa) {
+    return isa <= detect_simd_isa();
+}
+
+const char *simd_isa_name(simd_isa isa) {
+    switch (isa) {
+        case simd_isa::sse42:
+            return "sse42";
+        case simd_isa::avx2:
+            return "avx2";
+        case simd_isa::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
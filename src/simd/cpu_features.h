@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * Runtime detection of the SIMD instruction sets (cpuid)
+ * The program is compiled for the baseline x86-64 CPU, only the kernels in the simd/kernels_*.cpp files are compiled
+ * for the newer instruction sets -- the best one supported by the CPU (and the OS) is picked at startup
+ */
+
+/** Instruction sets with their own kernels (from the oldest one, every next one needs the previous ones) */
+enum class simd_isa {
+    scalar,
+    sse42,
+    avx2,
+    avx512
+};
+
+/** All the instruction sets (in order) */
+constexpr simd_isa simd_isas[] = {simd_isa::scalar, simd_isa::sse42, simd_isa::avx2, simd_isa::avx512};
+
+/**
+ * Best instruction set supported by the CPU and the OS (detected once, by cpuid and xgetbv)
+ * SSE4.2 needs POPCNT too, AVX2 needs the OS to save the YMM registers, AVX-512 needs F and BW and the OS to save
+ * the ZMM and mask registers
+ * @return Best supported instruction set
+ */
+simd_isa detect_simd_isa();
+
+/**
+ * Check whether the instruction set can be used on this CPU
+ * @param isa Instruction set
+ * @return True if it is supported
+ */
+bool simd_isa_supported(simd_isa isa);
+
+/**
+ * Name of the instruction set (--isa flag, outputs and graphs)
+ * @param isa Instruction set
+ * @return Name (scalar, sse42, avx2, avx512)
+ */
+const char *simd_isa_name(simd_isa isa);
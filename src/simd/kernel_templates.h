@@ -0,0 +1,472 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "simd/simd_kernels.h"
+
+/*
+ * The SIMD kernels, written once for all the instruction sets
+ * Included only by the simd/kernels_*.cpp files, each instantiates the kernels with the traits of its instruction set
+ * (and is compiled with its flags)
+ *
+ * Traits of the decimal registers (vec):
+ *   reg, lanes                         -- register type, number of decimals in it
+ *   load, loadu, store, storeu         -- aligned / unaligned memory access
+ *   set1, zero, add, sub, mul, min, max, abs
+ *   reverse                            -- reverse the order of the lanes
+ *   sort_bitonic                       -- sort a bitonic register
+ *   transpose                          -- transpose lanes registers (lanes x lanes block)
+ * Traits of the byte registers (bytes):
+ *   block_size                         -- number of bytes compared at once (at most 64)
+ *   match                              -- compare block_size bytes with the character, one bit per byte
+ *
+ * Everything is in an anonymous namespace and no standard library algorithms are used -- an inline function compiled
+ * in here would contain the instructions of this instruction set, and the linker could pick this copy for the whole
+ * program
+ */
+
+namespace {
+
+/**
+ * Count the set bits of the mask
+ * @param mask Mask
+ * @return Number of set bits
+ */
+inline size_t popcount64(uint64_t mask) {
+    #if defined(_MSC_VER) && defined(__AVX2__)
+    return __popcnt64(mask);
+    #elif defined(_MSC_VER)
+    /* No POPCNT instruction guaranteed -- bit counting in parallel (SWAR) */
+    mask = mask - ((mask >> 1) & 0x5555555555555555ull);
+    mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (mask * 0x0101010101010101ull) >> 56;
+    #else
+    return __builtin_popcountll(mask);
+    #endif
+}
+
+/**
+ * Index of the lowest set bit of the mask (mask must not be zero)
+ * @param mask Mask
+ * @return Index of the lowest set bit
+ */
+inline size_t trailing_zeros64(uint64_t mask) {
+    #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+    #else
+    return __builtin_ctzll(mask);
+    #endif
+}
+
+/**
+ * Number of comparators of Batcher's odd-even merge sort of n elements (n is a power of two)
+ * @param n Number of elements
+ * @return Number of comparators
+ */
+constexpr size_t batcher_network_size(size_t n) {
+    size_t size = 0;
+    for (size_t p = 1; p < n; p *= 2)
+        for (size_t k = p; k > 0; k /= 2)
+            for (size_t j = k % p; j + k < n; j += 2 * k)
+                for (size_t i = 0; i < k && i + j + k < n; i++)
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                        size++;
+    return size;
+}
+
+/**
+ * Batcher's odd-even merge sort network of n elements (n is a power of two) -- generated at compile time
+ * 2 elements: 1 comparator, 4: 5, 8: 19, 16: 63
+ * @tparam n Number of elements (rows of the block)
+ */
+template <size_t n>
+struct batcher_network {
+    /** Number of comparators */
+    static constexpr size_t size = batcher_network_size(n);
+    /** Comparators -- pairs of rows, the lower one gets the minimum */
+    size_t pairs[size ? size : 1][2] = {};
+
+    constexpr batcher_network() {
+        size_t c = 0;
+        for (size_t p = 1; p < n; p *= 2)
+            for (size_t k = p; k > 0; k /= 2)
+                for (size_t j = k % p; j + k < n; j += 2 * k)
+                    for (size_t i = 0; i < k && i + j + k < n; i++)
+                        if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                            pairs[c][0] = i + j;
+                            pairs[c][1] = i + j + k;
+                            c++;
+                        }
+    }
+};
+
+/**
+ * Absolute differences from the median
+ * @tparam vec Traits of the decimal registers
+ * @param arr Array (aligned)
+ * @param n Number of elements
+ * @param median Median
+ * @param diff Absolute differences (output, aligned)
+ */
+template <typename vec>
+void abs_diff_kernel(const decimal *arr, size_t n, decimal median, decimal *diff) {
+    const auto median_vec = vec::set1(median);
+
+    size_t i = 0;
+    for (; i + vec::lanes <= n; i += vec::lanes)
+        vec::store(diff + i, vec::abs(vec::sub(vec::load(arr + i), median_vec)));
+
+    /* Rest (less than one register) */
+    for (; i < n; i++)
+        diff[i] = std::abs(arr[i] - median);
+}
+
+/**
+ * Sum and sum of squares (added to the outputs)
+ * @tparam vec Traits of the decimal registers
+ * @tparam aligned Aligned loads (the array has to be aligned) or unaligned ones
+ * @param arr Array
+ * @param n Number of elements
+ * @param sum Sum (output, added to)
+ * @param sum_sq Sum of squares (output, added to)
+ */
+template <typename vec, bool aligned>
+void sums_kernel(const decimal *arr, size_t n, decimal &sum, decimal &sum_sq) {
+    auto sum_vec = vec::zero();
+    auto sum_sq_vec = vec::zero();
+
+    size_t i = 0;
+    for (; i + vec::lanes <= n; i += vec::lanes) {
+        const auto arr_vec = aligned ? vec::load(arr + i) : vec::loadu(arr + i);
+        sum_vec = vec::add(sum_vec, arr_vec);
+        sum_sq_vec = vec::add(sum_sq_vec, vec::mul(arr_vec, arr_vec));
+    }
+
+    /* Extract the sums from the registers (on the stack -- no allocation) and combine them */
+    decimal sum_lanes[vec::lanes];
+    decimal sum_sq_lanes[vec::lanes];
+    vec::storeu(sum_lanes, sum_vec);
+    vec::storeu(sum_sq_lanes, sum_sq_vec);
+    decimal local_sum = 0;
+    decimal local_sum_sq = 0;
+    for (size_t j = 0; j < vec::lanes; j++) {
+        local_sum += sum_lanes[j];
+        local_sum_sq += sum_sq_lanes[j];
+    }
+
+    /* Rest (less than one register) */
+    for (; i < n; i++) {
+        local_sum += arr[i];
+        local_sum_sq += arr[i] * arr[i];
+    }
+
+    sum += local_sum;
+    sum_sq += local_sum_sq;
+}
+
+/**
+ * Compare-exchange of two registers, lane by lane (a gets the minima, b the maxima)
+ * @tparam vec Traits of the decimal registers
+ * @param a First register
+ * @param b Second register
+ */
+template <typename vec>
+inline void compare_exchange(typename vec::reg &a, typename vec::reg &b) {
+    const auto min = vec::min(a, b);
+    b = vec::max(a, b);
+    a = min;
+}
+
+/**
+ * Bitonic merge of two sorted registers
+ * The second one is reversed (the pair is bitonic then), one compare-exchange splits the smaller and the larger half,
+ * both halves are bitonic and get sorted in the registers
+ * @tparam vec Traits of the decimal registers
+ * @param a Sorted register (output: the smaller half, sorted)
+ * @param b Sorted register (output: the larger half, sorted)
+ */
+template <typename vec>
+inline void bitonic_merge(typename vec::reg &a, typename vec::reg &b) {
+    b = vec::reverse(b);
+    compare_exchange<vec>(a, b);
+    a = vec::sort_bitonic(a);
+    b = vec::sort_bitonic(b);
+}
+
+/**
+ * Sort one block of lanes x lanes decimals into lanes runs of lanes decimals
+ * @tparam vec Traits of the decimal registers
+ * @param block Block
+ */
+template <typename vec>
+void sort_block(decimal *block) {
+    static constexpr batcher_network<vec::lanes> network{};
+
+    typename vec::reg rows[vec::lanes];
+    for (size_t i = 0; i < vec::lanes; i++)
+        rows[i] = vec::loadu(block + i * vec::lanes);
+
+    /* Sort the columns -- every comparator works on all the columns at once */
+    for (size_t i = 0; i < network.size; i++)
+        compare_exchange<vec>(rows[network.pairs[i][0]], rows[network.pairs[i][1]]);
+
+    /* The sorted columns become the rows (runs) */
+    vec::transpose(rows);
+    for (size_t i = 0; i < vec::lanes; i++)
+        vec::storeu(block + i * vec::lanes, rows[i]);
+}
+
+/**
+ * Sort the array in runs of lanes decimals (see simd_kernels::sort_runs)
+ * @tparam vec Traits of the decimal registers
+ * @param arr Array
+ * @param n Number of elements
+ */
+template <typename vec>
+void sort_runs_kernel(decimal *arr, size_t n) {
+    constexpr size_t block_size = vec::lanes * vec::lanes;
+
+    size_t i = 0;
+    for (; i + block_size <= n; i += block_size)
+        sort_block<vec>(arr + i);
+
+    /* Rest -- runs of lanes decimals (the last one may be shorter) by insertion sort */
+    for (; i < n; i += vec::lanes) {
+        decimal *run = arr + i;
+        const size_t run_size = n - i < vec::lanes ? n - i : vec::lanes;
+        for (size_t j = 1; j < run_size; j++) {
+            const decimal val = run[j];
+            size_t k = j;
+            for (; k > 0 && run[k - 1] > val; k--)
+                run[k] = run[k - 1];
+            run[k] = val;
+        }
+    }
+}
+
+/**
+ * Scalar merge of two sorted arrays (stable -- equal elements are taken from the first array first)
+ * @param a First sorted array
+ * @param na Number of elements of the first array
+ * @param b Second sorted array
+ * @param nb Number of elements of the second array
+ * @param out Output
+ * @return End of the output
+ */
+inline decimal *merge_scalar(const decimal *a, size_t na, const decimal *b, size_t nb, decimal *out) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb)
+        *out++ = b[j] < a[i] ? b[j++] : a[i++];
+    while (i < na)
+        *out++ = a[i++];
+    while (j < nb)
+        *out++ = b[j++];
+    return out;
+}
+
+/**
+ * Merge two sorted arrays into the output, one register at a time (see simd_kernels::merge)
+ * @tparam vec Traits of the decimal registers
+ * @param a First sorted array
+ * @param na Number of elements of the first array
+ * @param b Second sorted array
+ * @param nb Number of elements of the second array
+ * @param out Output (na + nb elements, must not overlap with the inputs)
+ */
+template <typename vec>
+void merge_kernel(const decimal *a, size_t na, const decimal *b, size_t nb, decimal *out) {
+    constexpr size_t lanes = vec::lanes;
+
+    /* Too short for the registers */
+    if (na < lanes || nb < lanes) {
+        merge_scalar(a, na, b, nb, out);
+        return;
+    }
+
+    auto low = vec::loadu(a);
+    auto high = vec::loadu(b);
+    size_t ia = lanes, ib = lanes;
+
+    while (true) {
+        /* The smaller half is final -- nothing left in the inputs can be smaller */
+        bitonic_merge<vec>(low, high);
+        vec::storeu(out, low);
+        out += lanes;
+
+        /* Next register from the input with the smaller next number (if it has a whole register left) */
+        const bool take_a = ib == nb || (ia < na && a[ia] <= b[ib]);
+        if (take_a ? ia + lanes > na : ib + lanes > nb)
+            break;
+        if (take_a) {
+            low = vec::loadu(a + ia);
+            ia += lanes;
+        } else {
+            low = vec::loadu(b + ib);
+            ib += lanes;
+        }
+    }
+
+    /* Rest -- the larger half from the registers, the short rest of one input and the rest of the other one */
+    decimal rest_high[lanes];
+    vec::storeu(rest_high, high);
+    decimal rest_short[2 * lanes];
+    if (na - ia < lanes) {
+        const decimal *short_end = merge_scalar(rest_high, lanes, a + ia, na - ia, rest_short);
+        merge_scalar(rest_short, short_end - rest_short, b + ib, nb - ib, out);
+    } else {
+        const decimal *short_end = merge_scalar(rest_high, lanes, b + ib, nb - ib, rest_short);
+        merge_scalar(rest_short, short_end - rest_short, a + ia, na - ia, out);
+    }
+}
+
+/**
+ * Compare one block of bytes with the character and compress the result into a mask
+ * Bytes past the end are never read -- the last incomplete block is copied into a padded block first
+ * (the bits of the padding are cleared)
+ * @tparam bytes Traits of the byte registers
+ * @param ptr Start of the block
+ * @param end End of the buffer
+ * @param c Character to look for
+ * @return Mask with bit i set if ptr[i] == c
+ */
+template <typename bytes>
+inline uint64_t match_mask(const char *ptr, const char *end, char c) {
+    const size_t left = static_cast<size_t>(end - ptr);
+    if (left >= bytes::block_size)
+        return bytes::match(ptr, c);
+
+    alignas(64) char padded[bytes::block_size] = {};
+    for (size_t i = 0; i < left; i++)
+        padded[i] = ptr[i];
+    return bytes::match(padded, c) & ((uint64_t(1) << left) - 1);
+}
+
+/**
+ * Count occurrences of the character in the buffer
+ * @tparam bytes Traits of the byte registers
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to count
+ * @return Number of occurrences
+ */
+template <typename bytes>
+size_t count_char_kernel(const char *begin, const char *end, char c) {
+    size_t count = 0;
+
+    for (const char *ptr = begin; ptr < end; ptr += bytes::block_size)
+        count += popcount64(match_mask<bytes>(ptr, end, c));
+
+    return count;
+}
+
+/**
+ * Find the first occurrence of the character in the buffer
+ * @tparam bytes Traits of the byte registers
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to look for
+ * @return Pointer to the first occurrence, or end if there is none
+ */
+template <typename bytes>
+const char *find_char_kernel(const char *begin, const char *end, char c) {
+    for (const char *ptr = begin; ptr < end; ptr += bytes::block_size) {
+        const uint64_t mask = match_mask<bytes>(ptr, end, c);
+        if (mask)
+            return ptr + trailing_zeros64(mask);
+    }
+
+    return end;
+}
+
+/**
+ * Positions of all occurrences of the character -- the masks are flattened with the trailing zero count,
+ * without any per-byte branching
+ * @tparam bytes Traits of the byte registers
+ * @param begin Start of the buffer
+ * @param end End of the buffer
+ * @param c Character to look for
+ * @param positions Positions (output, room for every occurrence)
+ * @return Number of occurrences
+ */
+template <typename bytes>
+size_t index_char_kernel(const char *begin, const char *end, char c, size_t *positions) {
+    size_t *out = positions;
+
+    for (const char *ptr = begin; ptr < end; ptr += bytes::block_size) {
+        uint64_t mask = match_mask<bytes>(ptr, end, c);
+        const size_t offset = ptr - begin;
+        while (mask) {
+            *out++ = offset + trailing_zeros64(mask);
+            mask &= mask - 1;  /* Clear the lowest set bit */
+        }
+    }
+
+    return out - positions;
+}
+
+/**
+ * Positions of the commas on one line (see find_commas in the csv_scanner.h file)
+ * @tparam bytes Traits of the byte registers
+ * @param line Start of the line
+ * @param end End of the buffer
+ * @param commas Positions of the commas (output, at least max_commas elements)
+ * @param max_commas Maximum number of commas to find
+ * @return Number of commas found
+ */
+template <typename bytes>
+size_t find_commas_kernel(const char *line, const char *end, const char **commas, size_t max_commas) {
+    size_t count = 0;
+
+    for (const char *ptr = line; ptr < end && count < max_commas; ptr += bytes::block_size) {
+        /* Only the commas before the end of the line are of interest */
+        uint64_t comma_mask = match_mask<bytes>(ptr, end, ',');
+        const uint64_t newline_mask = match_mask<bytes>(ptr, end, '\n');
+        if (newline_mask)
+            comma_mask &= (uint64_t(1) << trailing_zeros64(newline_mask)) - 1;  /* Bits below the first newline */
+
+        while (comma_mask && count < max_commas) {
+            commas[count++] = ptr + trailing_zeros64(comma_mask);
+            comma_mask &= comma_mask - 1;  /* Clear the lowest set bit */
+        }
+
+        if (newline_mask)
+            break;
+    }
+
+    return count;
+}
+
+/**
+ * Table of the kernels instantiated with the traits of one instruction set
+ * @tparam vec Traits of the decimal registers
+ * @tparam bytes Traits of the byte registers
+ * @param isa Instruction set
+ * @return Kernels
+ */
+template <typename vec, typename bytes>
+constexpr simd_kernels make_kernels(simd_isa isa) {
+    return {
+        isa,
+        vec::lanes,
+        abs_diff_kernel<vec>,
+        sums_kernel<vec, true>,
+        sums_kernel<vec, false>,
+        sort_runs_kernel<vec>,
+        merge_kernel<vec>,
+        count_char_kernel<bytes>,
+        find_char_kernel<bytes>,
+        index_char_kernel<bytes>,
+        find_commas_kernel<bytes>
+    };
+}
+
+}
@@ -0,0 +1,123 @@
+/* Compiled with -mavx2 (see CMakeLists.txt) */
+#include "simd/kernel_templates.h"
+
+#include <immintrin.h>
+
+/**
+ * AVX2 registers of decimals
+ * @tparam T Decimal type
+ */
+template <typename T>
+struct avx2_traits;
+
+/** AVX2 register of 4 doubles */
+template <>
+struct avx2_traits<double> {
+    using reg = __m256d;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(double);
+
+    static inline reg load(const double *ptr) { return _mm256_load_pd(ptr); }
+    static inline reg loadu(const double *ptr) { return _mm256_loadu_pd(ptr); }
+    static inline void store(double *ptr, reg v) { _mm256_store_pd(ptr, v); }
+    static inline void storeu(double *ptr, reg v) { _mm256_storeu_pd(ptr, v); }
+    static inline reg set1(double val) { return _mm256_set1_pd(val); }
+    static inline reg zero() { return _mm256_setzero_pd(); }
+    static inline reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static inline reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+    static inline reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static inline reg abs(reg v) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v); }
+    static inline reg reverse(reg v) { return _mm256_permute4x64_pd(v, 0x1B); }
+
+    /* Compare-exchange of the lanes at distance 2, then 1 */
+    static inline reg sort_bitonic(reg v) {
+        reg t = _mm256_permute2f128_pd(v, v, 0x01);
+        v = _mm256_blend_pd(_mm256_min_pd(v, t), _mm256_max_pd(v, t), 0b1100);
+        t = _mm256_permute_pd(v, 0b0101);
+        return _mm256_blend_pd(_mm256_min_pd(v, t), _mm256_max_pd(v, t), 0b1010);
+    }
+
+    /* 4 x 4 block */
+    static inline void transpose(reg *r) {
+        const reg t0 = _mm256_unpacklo_pd(r[0], r[1]);
+        const reg t1 = _mm256_unpackhi_pd(r[0], r[1]);
+        const reg t2 = _mm256_unpacklo_pd(r[2], r[3]);
+        const reg t3 = _mm256_unpackhi_pd(r[2], r[3]);
+        r[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+        r[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+        r[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+        r[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+    }
+};
+
+/** AVX2 register of 8 floats */
+template <>
+struct avx2_traits<float> {
+    using reg = __m256;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(float);
+
+    static inline reg load(const float *ptr) { return _mm256_load_ps(ptr); }
+    static inline reg loadu(const float *ptr) { return _mm256_loadu_ps(ptr); }
+    static inline void store(float *ptr, reg v) { _mm256_store_ps(ptr, v); }
+    static inline void storeu(float *ptr, reg v) { _mm256_storeu_ps(ptr, v); }
+    static inline reg set1(float val) { return _mm256_set1_ps(val); }
+    static inline reg zero() { return _mm256_setzero_ps(); }
+    static inline reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static inline reg abs(reg v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+    static inline reg reverse(reg v) { return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+
+    /* Compare-exchange of the lanes at distance 4, then 2, then 1 */
+    static inline reg sort_bitonic(reg v) {
+        reg t = _mm256_permute2f128_ps(v, v, 0x01);
+        v = _mm256_blend_ps(_mm256_min_ps(v, t), _mm256_max_ps(v, t), 0xF0);
+        t = _mm256_permute_ps(v, 0x4E);
+        v = _mm256_blend_ps(_mm256_min_ps(v, t), _mm256_max_ps(v, t), 0xCC);
+        t = _mm256_permute_ps(v, 0xB1);
+        return _mm256_blend_ps(_mm256_min_ps(v, t), _mm256_max_ps(v, t), 0xAA);
+    }
+
+    /* 8 x 8 block */
+    static inline void transpose(reg *r) {
+        const reg t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        const reg t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        const reg t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        const reg t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        const reg t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        const reg t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        const reg t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        const reg t7 = _mm256_unpackhi_ps(r[6], r[7]);
+        const reg s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        const reg s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        const reg s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        const reg s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+        const reg s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+        const reg s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+        const reg s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+        const reg s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+        r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+        r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+        r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+        r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+        r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+        r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+        r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+        r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+    }
+};
+
+/** AVX2 register of 32 bytes */
+struct avx2_bytes {
+    static constexpr size_t block_size = sizeof(__m256i);
+
+    static inline uint64_t match(const char *ptr, char c) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+    }
+};
+
+const simd_kernels avx2_kernels = make_kernels<avx2_traits<decimal>, avx2_bytes>(simd_isa::avx2);
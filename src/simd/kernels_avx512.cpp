@@ -0,0 +1,150 @@
+/* Compiled with -mavx512f -mavx512bw (see CMakeLists.txt) */
+#include "simd/kernel_templates.h"
+
+/* GCC 12 warns about the _mm512_undefined_*() inside of its own intrinsics (GCC bug 105593) */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+/**
+ * Indices of the transpose of a lanes x lanes block (_mm512_permutex2var) -- generated at compile time
+ * The block is transposed by swapping its off-diagonal quarters, then the quarters of the quarters, ...
+ * Stage s works on the rows at distance d = lanes >> (s + 1): row i (bit d clear) keeps its columns with bit d clear
+ * and takes the columns of row i + d with bit d clear, row i + d gets the rest
+ * @tparam index_type Type of the indices (int64_t for doubles, int32_t for floats)
+ * @tparam lanes Number of lanes
+ */
+template <typename index_type, size_t lanes>
+struct transpose_indices {
+    /** Indices of the new row i (lower one), per stage */
+    alignas(64) index_type low[4][lanes] = {};
+    /** Indices of the new row i + d (upper one), per stage */
+    alignas(64) index_type high[4][lanes] = {};
+
+    constexpr transpose_indices() {
+        for (size_t s = 0, d = lanes / 2; d > 0; s++, d /= 2)
+            for (size_t k = 0; k < lanes; k++) {
+                /* Index lanes + j is lane j of the second register */
+                low[s][k] = static_cast<index_type>(k & d ? lanes + k - d : k);
+                high[s][k] = static_cast<index_type>(k & d ? lanes + k : k + d);
+            }
+    }
+};
+
+/**
+ * AVX-512 registers of decimals
+ * @tparam T Decimal type
+ */
+template <typename T>
+struct avx512_traits;
+
+/** AVX-512 register of 8 doubles */
+template <>
+struct avx512_traits<double> {
+    using reg = __m512d;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(double);
+    static constexpr transpose_indices<int64_t, lanes> indices{};
+
+    static inline reg load(const double *ptr) { return _mm512_load_pd(ptr); }
+    static inline reg loadu(const double *ptr) { return _mm512_loadu_pd(ptr); }
+    static inline void store(double *ptr, reg v) { _mm512_store_pd(ptr, v); }
+    static inline void storeu(double *ptr, reg v) { _mm512_storeu_pd(ptr, v); }
+    static inline reg set1(double val) { return _mm512_set1_pd(val); }
+    static inline reg zero() { return _mm512_setzero_pd(); }
+    static inline reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static inline reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+    static inline reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+    static inline reg abs(reg v) { return _mm512_abs_pd(v); }
+    static inline reg reverse(reg v) { return _mm512_permutexvar_pd(_mm512_setr_epi64(7, 6, 5, 4, 3, 2, 1, 0), v); }
+
+    /* Compare-exchange of the lanes at distance 4, then 2, then 1 (the upper lane of each pair gets the maximum) */
+    static inline reg sort_bitonic(reg v) {
+        reg t = _mm512_shuffle_f64x2(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+        v = _mm512_mask_blend_pd(0xF0, _mm512_min_pd(v, t), _mm512_max_pd(v, t));
+        t = _mm512_permutex_pd(v, _MM_SHUFFLE(1, 0, 3, 2));
+        v = _mm512_mask_blend_pd(0xCC, _mm512_min_pd(v, t), _mm512_max_pd(v, t));
+        t = _mm512_permute_pd(v, 0x55);
+        return _mm512_mask_blend_pd(0xAA, _mm512_min_pd(v, t), _mm512_max_pd(v, t));
+    }
+
+    /* 8 x 8 block */
+    static inline void transpose(reg *r) {
+        for (size_t s = 0, d = lanes / 2; d > 0; s++, d /= 2) {
+            const __m512i low = _mm512_load_si512(indices.low[s]);
+            const __m512i high = _mm512_load_si512(indices.high[s]);
+            for (size_t i = 0; i < lanes; i++)
+                if (!(i & d)) {
+                    const reg a = r[i];
+                    r[i] = _mm512_permutex2var_pd(a, low, r[i + d]);
+                    r[i + d] = _mm512_permutex2var_pd(a, high, r[i + d]);
+                }
+        }
+    }
+};
+
+/** AVX-512 register of 16 floats */
+template <>
+struct avx512_traits<float> {
+    using reg = __m512;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(float);
+    static constexpr transpose_indices<int32_t, lanes> indices{};
+
+    static inline reg load(const float *ptr) { return _mm512_load_ps(ptr); }
+    static inline reg loadu(const float *ptr) { return _mm512_loadu_ps(ptr); }
+    static inline void store(float *ptr, reg v) { _mm512_store_ps(ptr, v); }
+    static inline void storeu(float *ptr, reg v) { _mm512_storeu_ps(ptr, v); }
+    static inline reg set1(float val) { return _mm512_set1_ps(val); }
+    static inline reg zero() { return _mm512_setzero_ps(); }
+    static inline reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static inline reg abs(reg v) { return _mm512_abs_ps(v); }
+    static inline reg reverse(reg v) {
+        return _mm512_permutexvar_ps(_mm512_setr_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), v);
+    }
+
+    /* Compare-exchange of the lanes at distance 8, 4, 2, then 1 (the upper lane of each pair gets the maximum) */
+    static inline reg sort_bitonic(reg v) {
+        reg t = _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+        v = _mm512_mask_blend_ps(0xFF00, _mm512_min_ps(v, t), _mm512_max_ps(v, t));
+        t = _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm512_mask_blend_ps(0xF0F0, _mm512_min_ps(v, t), _mm512_max_ps(v, t));
+        t = _mm512_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2));
+        v = _mm512_mask_blend_ps(0xCCCC, _mm512_min_ps(v, t), _mm512_max_ps(v, t));
+        t = _mm512_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm512_mask_blend_ps(0xAAAA, _mm512_min_ps(v, t), _mm512_max_ps(v, t));
+    }
+
+    /* 16 x 16 block */
+    static inline void transpose(reg *r) {
+        for (size_t s = 0, d = lanes / 2; d > 0; s++, d /= 2) {
+            const __m512i low = _mm512_load_si512(indices.low[s]);
+            const __m512i high = _mm512_load_si512(indices.high[s]);
+            for (size_t i = 0; i < lanes; i++)
+                if (!(i & d)) {
+                    const reg a = r[i];
+                    r[i] = _mm512_permutex2var_ps(a, low, r[i + d]);
+                    r[i + d] = _mm512_permutex2var_ps(a, high, r[i + d]);
+                }
+        }
+    }
+};
+
+/** AVX-512 register of 64 bytes (AVX-512BW compares straight into a 64-bit mask) */
+struct avx512_bytes {
+    static constexpr size_t block_size = sizeof(__m512i);
+
+    static inline uint64_t match(const char *ptr, char c) {
+        const __m512i block = _mm512_loadu_si512(ptr);
+        return _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(c));
+    }
+};
+
+const simd_kernels avx512_kernels = make_kernels<avx512_traits<decimal>, avx512_bytes>(simd_isa::avx512);
@@ -0,0 +1,43 @@
+/* Compiled for the baseline CPU -- the fallback if the CPU has none of the instruction sets below */
+#include "simd/kernel_templates.h"
+
+/**
+ * "Register" of one decimal -- the kernels become plain loops (the compiler may still vectorize them with the baseline
+ * instructions)
+ * @tparam T Decimal type
+ */
+template <typename T>
+struct scalar_traits {
+    using reg = T;
+    static constexpr size_t lanes = 1;
+
+    static inline reg load(const T *ptr) { return *ptr; }
+    static inline reg loadu(const T *ptr) { return *ptr; }
+    static inline void store(T *ptr, reg v) { *ptr = v; }
+    static inline void storeu(T *ptr, reg v) { *ptr = v; }
+    static inline reg set1(T val) { return val; }
+    static inline reg zero() { return 0; }
+    static inline reg add(reg a, reg b) { return a + b; }
+    static inline reg sub(reg a, reg b) { return a - b; }
+    static inline reg mul(reg a, reg b) { return a * b; }
+    static inline reg min(reg a, reg b) { return a < b ? a : b; }
+    static inline reg max(reg a, reg b) { return a < b ? b : a; }
+    static inline reg abs(reg v) { return std::abs(v); }
+    static inline reg reverse(reg v) { return v; }
+    static inline reg sort_bitonic(reg v) { return v; }
+    static inline void transpose(reg *) {}
+};
+
+/** Bytes compared one by one (16 at a time, so the masks look the same as the SSE ones) */
+struct scalar_bytes {
+    static constexpr size_t block_size = 16;
+
+    static inline uint64_t match(const char *ptr, char c) {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < block_size; i++)
+            mask |= static_cast<uint64_t>(ptr[i] == c) << i;
+        return mask;
+    }
+};
+
+const simd_kernels scalar_kernels = make_kernels<scalar_traits<decimal>, scalar_bytes>(simd_isa::scalar);
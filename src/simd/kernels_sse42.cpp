@@ -0,0 +1,91 @@
+/* Compiled with -msse4.2 -mpopcnt (see CMakeLists.txt) */
+#include "simd/kernel_templates.h"
+
+#include <immintrin.h>
+
+/**
+ * SSE registers of decimals
+ * @tparam T Decimal type
+ */
+template <typename T>
+struct sse42_traits;
+
+/** SSE register of 2 doubles */
+template <>
+struct sse42_traits<double> {
+    using reg = __m128d;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(double);
+
+    static inline reg load(const double *ptr) { return _mm_load_pd(ptr); }
+    static inline reg loadu(const double *ptr) { return _mm_loadu_pd(ptr); }
+    static inline void store(double *ptr, reg v) { _mm_store_pd(ptr, v); }
+    static inline void storeu(double *ptr, reg v) { _mm_storeu_pd(ptr, v); }
+    static inline reg set1(double val) { return _mm_set1_pd(val); }
+    static inline reg zero() { return _mm_setzero_pd(); }
+    static inline reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    static inline reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+    static inline reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+    static inline reg abs(reg v) { return _mm_andnot_pd(_mm_set1_pd(-0.0), v); }
+    static inline reg reverse(reg v) { return _mm_shuffle_pd(v, v, 0b01); }
+
+    /* Compare-exchange of the lanes at distance 1 */
+    static inline reg sort_bitonic(reg v) {
+        const reg t = _mm_shuffle_pd(v, v, 0b01);
+        return _mm_blend_pd(_mm_min_pd(v, t), _mm_max_pd(v, t), 0b10);
+    }
+
+    /* 2 x 2 block */
+    static inline void transpose(reg *r) {
+        const reg t0 = _mm_unpacklo_pd(r[0], r[1]);
+        r[1] = _mm_unpackhi_pd(r[0], r[1]);
+        r[0] = t0;
+    }
+};
+
+/** SSE register of 4 floats */
+template <>
+struct sse42_traits<float> {
+    using reg = __m128;
+    static constexpr size_t lanes = sizeof(reg) / sizeof(float);
+
+    static inline reg load(const float *ptr) { return _mm_load_ps(ptr); }
+    static inline reg loadu(const float *ptr) { return _mm_loadu_ps(ptr); }
+    static inline void store(float *ptr, reg v) { _mm_store_ps(ptr, v); }
+    static inline void storeu(float *ptr, reg v) { _mm_storeu_ps(ptr, v); }
+    static inline reg set1(float val) { return _mm_set1_ps(val); }
+    static inline reg zero() { return _mm_setzero_ps(); }
+    static inline reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static inline reg abs(reg v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+    static inline reg reverse(reg v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+    /* Compare-exchange of the lanes at distance 2, then 1 */
+    static inline reg sort_bitonic(reg v) {
+        reg t = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+        v = _mm_blend_ps(_mm_min_ps(v, t), _mm_max_ps(v, t), 0b1100);
+        t = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm_blend_ps(_mm_min_ps(v, t), _mm_max_ps(v, t), 0b1010);
+    }
+
+    /* 4 x 4 block */
+    static inline void transpose(reg *r) {
+        _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+    }
+};
+
+/** SSE register of 16 bytes */
+struct sse42_bytes {
+    static constexpr size_t block_size = sizeof(__m128i);
+
+    static inline uint64_t match(const char *ptr, char c) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+    }
+};
+
+const simd_kernels sse42_kernels = make_kernels<sse42_traits<decimal>, sse42_bytes>(simd_isa::sse42);
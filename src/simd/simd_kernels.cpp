@@ -0,0 +1,18 @@
+#include "simd/simd_kernels.h"
+
+const simd_kernels &get_simd_kernels(simd_isa isa) {
+    switch (isa) {
+        case simd_isa::sse42:
+            return sse42_kernels;
+        case simd_isa::avx2:
+            return avx2_kernels;
+        case simd_isa::avx512:
+            return avx512_kernels;
+        default:
+            return scalar_kernels;
+    }
+}
+
+const simd_kernels &get_simd_kernels() {
+    return get_simd_kernels(detect_simd_isa());
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+
+#include "simd/cpu_features.h"
+#include "utils/utils.h"
+
+/*
+ * Table of the SIMD kernels of one instruction set
+ * The kernels are written only once (simd/kernel_templates.h), as templates over the traits of the registers
+ * (load, add, min, shuffles, ...), and instantiated in one file per instruction set (simd/kernels_*.cpp), which is
+ * the only file compiled with the flags of that instruction set
+ * Callers pick the table at runtime (get_simd_kernels) and call the kernels through it -- nothing else in the program
+ * contains instructions the CPU might not have
+ */
+
+/** Alignment of the aligned loads of all the instruction sets (one AVX-512 register, alignment of decimal_vector) */
+constexpr size_t simd_alignment = 64;
+
+/**
+ * Kernels of one instruction set
+ * The arithmetic kernels work on decimals, the scanner kernels on the bytes of the CSV files
+ */
+struct simd_kernels {
+    /** Instruction set of the kernels */
+    simd_isa isa;
+    /** Number of decimals in one register (the sorted runs of sort_runs) */
+    size_t lanes;
+
+    /**
+     * Absolute differences from the median, diff[i] = |arr[i] - median|
+     * arr and diff have to be aligned to simd_alignment bytes (aligned loads and stores)
+     */
+    void (*abs_diff)(const decimal *arr, size_t n, decimal median, decimal *diff);
+    /**
+     * Sum and sum of squares of the array, added to sum and sum_sq
+     * arr has to be aligned to simd_alignment bytes (aligned loads)
+     */
+    void (*sums)(const decimal *arr, size_t n, decimal &sum, decimal &sum_sq);
+    /** The same as sums, with unaligned loads (any address) */
+    void (*sums_unaligned)(const decimal *arr, size_t n, decimal &sum, decimal &sum_sq);
+
+    /**
+     * Sort the array in runs of lanes decimals -- run i is [i * lanes, (i + 1) * lanes)
+     * Blocks of lanes x lanes decimals are sorted by the sorting network and transposed, the rest by insertion sort
+     */
+    void (*sort_runs)(decimal *arr, size_t n);
+    /** Merge two sorted arrays into the output (bitonic merge network of two registers, out must not overlap) */
+    void (*merge)(const decimal *a, size_t na, const decimal *b, size_t nb, decimal *out);
+
+    /** Count occurrences of the character in the buffer */
+    size_t (*count_char)(const char *begin, const char *end, char c);
+    /** Find the first occurrence of the character in the buffer (end if there is none) */
+    const char *(*find_char)(const char *begin, const char *end, char c);
+    /**
+     * Positions (offsets from begin) of all occurrences of the character, returns their number
+     * positions has to have room for every occurrence (end - begin positions at most)
+     */
+    size_t (*index_char)(const char *begin, const char *end, char c, size_t *positions);
+    /** Positions of the commas on one line (see find_commas in the csv_scanner.h file) */
+    size_t (*find_commas)(const char *line, const char *end, const char **commas, size_t max_commas);
+};
+
+/** Kernels compiled for the baseline CPU (no intrinsics) */
+extern const simd_kernels scalar_kernels;
+/** Kernels compiled with SSE4.2 and POPCNT */
+extern const simd_kernels sse42_kernels;
+/** Kernels compiled with AVX2 */
+extern const simd_kernels avx2_kernels;
+/** Kernels compiled with AVX-512 (F, BW) */
+extern const simd_kernels avx512_kernels;
+
+/**
+ * Kernels of the instruction set (the caller has to check that the CPU supports it -- simd_isa_supported)
+ * @param isa Instruction set
+ * @return Kernels
+ */
+const simd_kernels &get_simd_kernels(simd_isa isa);
+
+/**
+ * Kernels of the best instruction set supported by the CPU
+ * @return Kernels
+ */
+const simd_kernels &get_simd_kernels();
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <new>
+#include <cstddef>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/** Alignment of the data arrays (one cache line, also enough for aligned AVX2 / AVX-512 loads) */
+constexpr size_t data_alignment = 64;
+/** Size of a (transparent) huge page -- larger arrays are aligned to it, so that they can be backed by huge pages */
+constexpr size_t huge_page_size = 2 << 20;
+
+/**
+ * Whether the large arrays should be backed by transparent huge pages (madvise(MADV_HUGEPAGE), Linux only)
+ * Set once at the start of the program (--huge_pages flag), read by every allocation
+ */
+inline bool huge_pages_enabled = false;
+
+/**
+ * Allocator of 64-byte aligned arrays (std::vector<decimal> cannot be used with aligned AVX2 loads)
+ * Arrays of at least one huge page are aligned to the huge page size, and if huge pages are enabled,
+ * the kernel is asked to back them by transparent huge pages (less TLB misses on large sorts)
+ * This class has to be implemented in here (.h), because of the template
+ * @tparam T Type of the elements
+ */
+template <typename T>
+class aligned_allocator {
+public:
+    /** Type of the elements (required by the standard containers) */
+    using value_type = T;
+
+    /**
+     * Constructor
+     */
+    aligned_allocator() noexcept = default;
+
+    /**
+     * Converting constructor (required by the standard containers)
+     * @tparam U Type of the elements of the other allocator
+     */
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U> &) noexcept {
+        /* Nothing to do here -- the allocator has no state */
+    }
+
+    /**
+     * Allocate the aligned array
+     * @param n Number of elements
+     * @return Pointer to the array
+     */
+    [[nodiscard]] T *allocate(size_t n) {
+        const size_t bytes = n * sizeof(T);
+        void *ptr = ::operator new(bytes, std::align_val_t(alignment(bytes)));
+
+        #ifdef __linux__
+        /* Only a hint -- if transparent huge pages are disabled in the system, nothing happens */
+        if (huge_pages_enabled && bytes >= huge_page_size)
+            madvise(ptr, bytes, MADV_HUGEPAGE);
+        #endif
+
+        return static_cast<T *>(ptr);
+    }
+
+    /**
+     * Release the array allocated by allocate
+     * @param ptr Pointer to the array
+     * @param n Number of elements
+     */
+    void deallocate(T *ptr, size_t n) noexcept {
+        ::operator delete(ptr, std::align_val_t(alignment(n * sizeof(T))));
+    }
+
+private:
+    /**
+     * Alignment of the array of the given size (the same one for allocate and deallocate)
+     * @param bytes Size of the array in bytes
+     * @return Alignment
+     */
+    static size_t alignment(size_t bytes) {
+        return bytes >= huge_page_size ? huge_page_size : data_alignment;
+    }
+};
+
+/**
+ * All the aligned allocators are interchangeable (no state)
+ * @return Always true
+ */
+template <typename T, typename U>
+bool operator==(const aligned_allocator<T> &, const aligned_allocator<U> &) noexcept {
+    return true;
+}
+
+/**
+ * All the aligned allocators are interchangeable (no state)
+ * @return Always false
+ */
+template <typename T, typename U>
+bool operator!=(const aligned_allocator<T> &, const aligned_allocator<U> &) noexcept {
+    return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Bounded blocking queue (multiple producers, multiple consumers)
+ * Producers block while the queue is full, consumers block while it is empty
+ * After close() the producers are refused and the consumers drain the remaining items
+ * This class has to be implemented in here (.h), because of the template
+ * @tparam T Type of the items
+ */
+template <typename T>
+class bounded_queue {
+private:
+    /** Maximum number of items in the queue */
+    size_t capacity;
+    /** Whether the queue was closed */
+    bool closed = false;
+    /** Items */
+    std::queue<T> items;
+    /** Mutex guarding the items */
+    std::mutex mutex;
+    /** Signalled when an item was pushed (or the queue was closed) */
+    std::condition_variable not_empty;
+    /** Signalled when an item was popped (or the queue was closed) */
+    std::condition_variable not_full;
+
+public:
+    /**
+     * Constructor
+     * @param capacity Maximum number of items in the queue (at least one)
+     */
+    explicit bounded_queue(size_t capacity) : capacity(capacity ? capacity : 1) {
+        /* Nothing to do here */
+    }
+
+    /**
+     * Push the item, blocks while the queue is full
+     * @param item Item
+     * @return False if the queue was closed (the item is dropped), true otherwise
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_full.wait(lock, [&]() { return this->closed || this->items.size() < this->capacity; });
+        if (this->closed)
+            return false;
+
+        this->items.push(std::move(item));
+        lock.unlock();
+        this->not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Pop the oldest item, blocks while the queue is empty
+     * @param item Popped item (output)
+     * @return False if the queue was closed and is empty, true otherwise
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->not_empty.wait(lock, [&]() { return this->closed || !this->items.empty(); });
+        if (this->items.empty())
+            return false;
+
+        item = std::move(this->items.front());
+        this->items.pop();
+        lock.unlock();
+        this->not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * Close the queue -- wakes up everyone waiting, no more items can be pushed
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->closed = true;
+        }
+        this->not_empty.notify_all();
+        this->not_full.notify_all();
+    }
+};
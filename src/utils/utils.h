@@ -1,5 +1,9 @@
 #pragma once
 
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+
 /* Decimal type, can be changed by user to float, by default it is double */
 #ifdef _USE_FLOAT
 using decimal = float;
@@ -7,6 +11,9 @@ using decimal = float;
 using decimal = double;
 #endif
 
+/* Array of decimals -- 64-byte aligned (aligned SIMD loads), optionally backed by huge pages */
+using decimal_vector = std::vector<decimal, aligned_allocator<decimal>>;
+
 /* Un-define max and min macros, so that std::max, std::min and limits can be used */
 #ifdef max
 #undef max